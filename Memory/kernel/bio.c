@@ -26,6 +26,8 @@
 struct {
   struct spinlock lock;
   struct buf buf[NBUF];
+  uint size;  // block size, set from the super block by bsetsize()
+  int nheld;  // buffers held by bhold()
 
   // Linked list of all buffers, through prev/next.
   // Sorted by how recently the buffer was used.
@@ -39,6 +41,7 @@ binit(void)
   struct buf *b;
 
   initlock(&bcache.lock, "bcache");
+  bcache.size = BSIZE;
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
@@ -46,12 +49,32 @@ binit(void)
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
     b->next = bcache.head.next;
     b->prev = &bcache.head;
+    b->size = bcache.size;
     initsleeplock(&b->lock, "buffer");
     bcache.head.next->prev = b;
     bcache.head.next = b;
   }
 }
 
+// Switch the cache to blocks of size bytes once the super block
+// has been read, dropping the contents of cached blocks, which
+// were read with the old size. No buffer may be in use.
+void
+bsetsize(uint size)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+    if(b->refcnt != 0)
+      panic("bsetsize");
+    b->valid = 0;
+    b->size = size;
+  }
+  bcache.size = size;
+  release(&bcache.lock);
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
@@ -60,14 +83,20 @@ bget(uint dev, uint blockno)
 {
   struct buf *b;
 
+again:
   acquire(&bcache.lock);
 
   // Is the block already cached?
   for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
+    if(b->dev == dev && b->blockno == blockno && !b->orphan){
       b->refcnt++;
       release(&bcache.lock);
       acquiresleep(&b->lock);
+      if(b->orphan){
+        // bunshare() gave the block a new buffer while we waited.
+        brelse(b);
+        goto again;
+      }
       return b;
     }
   }
@@ -79,6 +108,7 @@ bget(uint dev, uint blockno)
       b->dev = dev;
       b->blockno = blockno;
       b->valid = 0;
+      b->orphan = 0;
       b->refcnt = 1;
       release(&bcache.lock);
       acquiresleep(&b->lock);
@@ -112,6 +142,53 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
+// Start reading the indicated block into the cache, unless it
+// is cached already, without waiting for the read to finish.
+// A later bread() waits for the read on the buffer's lock.
+// Gives up quietly if no buffer or disk descriptor is free.
+void
+breadahead(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno && !b->orphan){
+      release(&bcache.lock);
+      return;
+    }
+  }
+
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0) {
+      b->dev = dev;
+      b->blockno = blockno;
+      b->valid = 0;
+      b->orphan = 0;
+      b->refcnt = 1;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);  // refcnt was 0, so this won't block
+      if(virtio_disk_read_async(b) < 0)
+        brelse(b);
+      return;
+    }
+  }
+  release(&bcache.lock);
+}
+
+static void bunref(struct buf *b);
+
+// Called by the disk interrupt when a read started by
+// breadahead() completes: release the buffer on behalf of
+// the process that started the read.
+void
+bdone(struct buf *b)
+{
+  releasesleep(&b->lock);
+  bunref(b);
+}
+
 // Release a locked buffer.
 // Move to the head of the most-recently-used list.
 void
@@ -121,7 +198,14 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bunref(b);
+}
 
+// Drop a reference to b; if it was the last, move b
+// to the head of the most-recently-used list.
+static void
+bunref(struct buf *b)
+{
   acquire(&bcache.lock);
   b->refcnt--;
   if (b->refcnt == 0) {
@@ -137,9 +221,110 @@ brelse(struct buf *b)
   release(&bcache.lock);
 }
 
+// At most this many buffers may be held by bhold(), so that
+// file system calls always find a free buffer.
+#define MAXHELD (NBUF/4)
+
+// Keep b's contents in the cache after the caller releases it,
+// for a reader that does not take b's lock: a pipe that b was
+// spliced into. The contents stay as they are now: a later
+// write to the block goes through bunshare(), which moves the
+// block to a new buffer. Must be locked. Returns 0 if too many
+// buffers are held, or if b is changed in an open log
+// transaction, whose commit expects to find b at its block.
+int
+bhold(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bhold");
+
+  acquire(&bcache.lock);
+  if(bcache.nheld >= MAXHELD || b->pins > 0){
+    release(&bcache.lock);
+    return 0;
+  }
+  bcache.nheld++;
+  b->held++;
+  b->refcnt++;
+  release(&bcache.lock);
+  return 1;
+}
+
+void
+bunhold(struct buf *b)
+{
+  acquire(&bcache.lock);
+  bcache.nheld--;
+  b->held--;
+  release(&bcache.lock);
+  bunref(b);
+}
+
+// Called with locked buffer b before changing its contents.
+// If b is held, leave it to its holders and return a locked
+// copy in another buffer, which bget() finds from now on.
+// Otherwise return b.
+struct buf*
+bunshare(struct buf *b)
+{
+  struct buf *nb;
+
+  if(!holdingsleep(&b->lock))
+    panic("bunshare");
+
+  acquire(&bcache.lock);
+  if(b->held == 0){
+    release(&bcache.lock);
+    return b;
+  }
+  for(nb = bcache.head.prev; nb != &bcache.head; nb = nb->prev)
+    if(nb->refcnt == 0)
+      break;
+  if(nb == &bcache.head)
+    panic("bunshare: no buffers");
+  nb->dev = b->dev;
+  nb->blockno = b->blockno;
+  nb->valid = 0;  // a bget() that wins nb->lock reads the disk
+  nb->orphan = 0;
+  nb->refcnt = 1;
+  b->orphan = 1;
+  release(&bcache.lock);
+
+  // b is not pinned, so the disk holds what b does; a racing
+  // reader that reads it first gets the same bytes.
+  acquiresleep(&nb->lock);
+  if(!nb->valid){
+    memmove(nb->data, b->data, b->size);
+    nb->valid = 1;
+  }
+  brelse(b);
+  return nb;
+}
+
+// Collect up to max block numbers in [lo, hi) on dev that are
+// held by bhold(), so balloc() can skip them: a pipe may still
+// read a held block after its file frees it. One scan covers a
+// whole bitmap block. Returns the number found.
+int
+bheld(uint dev, uint lo, uint hi, uint *blocks, int max)
+{
+  struct buf *b;
+  int n = 0;
+
+  acquire(&bcache.lock);
+  if(bcache.nheld > 0){
+    for(b = bcache.buf; b < bcache.buf+NBUF && n < max; b++)
+      if(b->held > 0 && b->dev == dev && b->blockno >= lo && b->blockno < hi)
+        blocks[n++] = b->blockno;
+  }
+  release(&bcache.lock);
+  return n;
+}
+
 void
 bpin(struct buf *b) {
   acquire(&bcache.lock);
+  b->pins++;
   b->refcnt++;
   release(&bcache.lock);
 }
@@ -147,6 +332,7 @@ bpin(struct buf *b) {
 void
 bunpin(struct buf *b) {
   acquire(&bcache.lock);
+  b->pins--;
   b->refcnt--;
   release(&bcache.lock);
 }
@@ -1,12 +1,17 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int async;   // read-ahead: release buf when the disk is done
   uint dev;
   uint blockno;
+  uint size;   // block size, in bytes
   struct sleeplock lock;
   uint refcnt;
+  int held;    // holds by bhold(); the block is not reallocated
+  int pins;    // pins by the log: changed in an open transaction
+  int orphan;  // replaced by a copy for writing; bget() skips it
   struct buf *prev; // LRU cache list
   struct buf *next;
-  uchar data[BSIZE];
+  uchar data[MAXBSIZE];
 };
 
@@ -6,42 +6,62 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "fs.h"
+#include "trace.h"
+
+// The hooks record trace events; the tracedump program prints
+// them. Build with TRACECONSOLE=1 to print each on the console
+// as well, at the cost of taking the console lock every time.
+#ifdef TRACECONSOLE
+#define tracecons(...) printf(__VA_ARGS__)
+#else
+#define tracecons(...)
+#endif
 
 void print_static_proc(char* name) {
-    printf("Static process creation (proc: %s)\n", name);
+    tracecons("Static process creation (proc: %s)\n", name);
+    trace(TR_STATIC_PROC, name, 0, 0, 0);
 }
 
 void print_ondemand_proc(char* name) {
-    printf("Ondemand process creation (proc: %s)\n", name);
+    tracecons("Ondemand process creation (proc: %s)\n", name);
+    trace(TR_ONDEMAND_PROC, name, 0, 0, 0);
 }
 
 void print_skip_section(char* name, uint64 vaddr, int size) {
-    printf("Skipping program section loading (proc: %s, addr: %x, size: %d)\n", 
+    tracecons("Skipping program section loading (proc: %s, addr: %x, size: %d)\n", 
         name, vaddr, size);
+    trace(TR_SKIP_SECTION, name, vaddr, size, 0);
 }
 
 void print_page_fault(char* name, uint64 vaddr) {
-    printf("----------------------------------------\n");
-    printf("#PF: Proc (%s), Page (%x)\n", name, vaddr);
+    tracecons("----------------------------------------\n");
+    tracecons("#PF: Proc (%s), Page (%x)\n", name, vaddr);
+    trace(TR_PAGE_FAULT, name, vaddr, 0, 0);
 }
 
 void print_evict_page(uint64 vaddr, int startblock) {
-    printf("EVICT: Page (%x) --> PSA (%d - %d)\n", vaddr, startblock, startblock+3);
+    tracecons("EVICT: Page (%x) --> PSA (%d - %d)\n", vaddr, startblock, startblock+PGSIZE/sb.bsize-1);
+    trace(TR_EVICT, 0, vaddr, startblock, startblock+PGSIZE/sb.bsize-1);
 }
 
 void print_retrieve_page(uint64 vaddr, int startblock) {
-    printf("RETRIEVE: Page (%x) --> PSA (%d - %d)\n", vaddr, startblock, startblock+3);
+    tracecons("RETRIEVE: Page (%x) --> PSA (%d - %d)\n", vaddr, startblock, startblock+PGSIZE/sb.bsize-1);
+    trace(TR_RETRIEVE, 0, vaddr, startblock, startblock+PGSIZE/sb.bsize-1);
 }
 
 void print_load_seg(uint64 vaddr, uint64 seg, int size) {
-    printf("LOAD: Addr (%x), SEG: (%x), SIZE (%d)\n", vaddr, seg, size);
+    tracecons("LOAD: Addr (%x), SEG: (%x), SIZE (%d)\n", vaddr, seg, size);
+    trace(TR_LOAD_SEG, 0, vaddr, seg, size);
 }
 
 void print_skip_heap_region(char* name, uint64 vaddr, int npages) {
-    printf("Skipping heap region allocation (proc: %s, addr: %x, npages: %d)\n", 
+    tracecons("Skipping heap region allocation (proc: %s, addr: %x, npages: %d)\n", 
         name, vaddr, npages);
+    trace(TR_SKIP_HEAP, name, vaddr, npages, 0);
 }
 
 void print_copy_on_write(struct proc *p, uint64 vaddr) {
-    printf("CoW: proc(%s)[%d] Addr (%x)\n", p->name, p->pid, vaddr);
-}
\ No newline at end of file
+    tracecons("CoW: proc(%s)[%d] Addr (%x)\n", p->name, p->pid, vaddr);
+    trace(TR_COW, p->name, vaddr, 0, 0);
+}
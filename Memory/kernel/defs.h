@@ -4,6 +4,8 @@ struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -16,6 +18,13 @@ void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            bsetsize(uint);
+void            breadahead(uint, uint);
+void            bdone(struct buf*);
+int             bhold(struct buf*);
+void            bunhold(struct buf*);
+int             bheld(uint, uint, uint, uint*, int);
+struct buf*     bunshare(struct buf*);
 
 // console.c
 void            consoleinit(void);
@@ -33,8 +42,10 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filesplice(struct file*, struct file*, int n);
 
 // fs.c
+extern struct superblock sb;
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
@@ -51,6 +62,7 @@ struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
+struct buf*     iblock(struct inode*, uint, uint);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
 
@@ -63,6 +75,8 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+uint64          kfreecount(void);
+void            kdup(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -75,6 +89,9 @@ int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
+int             pipesize(struct pipe*, int);
+int             pipesplice(struct pipe*, struct buf*, char*, uint, uint);
+int             pipevmsplice(struct pipe*, uint64, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -92,6 +109,7 @@ void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
+int             setsched(int, int, int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -117,6 +135,21 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstats(uint64, int);
+
+// rwlock.c
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
+
+// seqlock.c
+void            initseqlock(struct seqlock*, char*);
+void            writeseqlock(struct seqlock*);
+void            writesequnlock(struct seqlock*);
+uint            readseqbegin(struct seqlock*);
+int             readseqretry(struct seqlock*, uint);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -145,13 +178,15 @@ void            syscall();
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
+void            clockintr(void);
+extern struct seqlock tickslock;
 void            usertrapret(void);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
+void            uartwrite(char*, int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
@@ -184,6 +219,7 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+int             virtio_disk_read_async(struct buf *);
 void            virtio_disk_intr(void);
 
 // pfault.c
@@ -191,6 +227,27 @@ extern uint64   non_fault_addr;
 void            page_fault_handler(void);
 void            proc_pswap_diskblocks_init(void);
 
+// sched.c
+void            schedinit(void);
+void            rqadd(struct proc*);
+struct proc*    rqtake(int);
+void            schedcharge(struct proc*);
+int             needresched(int);
+int             rqempty(void);
+
+// timer.c
+void            timersinit(void);
+int             timersleep(uint64);
+void            timerintr(void);
+void            timertick(void);
+void            timeridle(void);
+void            timerkick(int);
+
+// trace.c
+void            traceinit(void);
+void            trace(int, char*, uint64, uint64, uint64);
+int             tracedump(uint64, int);
+
 // debug.h
 void print_static_proc(char* name);
 void print_ondemand_proc(char* name);
@@ -12,6 +12,9 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "buf.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 struct devsw devsw[NDEV];
 struct {
@@ -152,7 +155,7 @@ filewrite(struct file *f, uint64 addr, int n)
     // and 2 blocks of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int max = ((MAXOPBLOCKS-1-1-2) / 2) * sb.bsize;
     int i = 0;
     while(i < n){
       int n1 = n - i;
@@ -180,3 +183,61 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Move up to n bytes from file in to pipe out, queuing
+// references to buffer-cache blocks instead of copying
+// through user space. The pipe gets the data as it is now,
+// as read() would. Copies a block only if it is a hole, too
+// many blocks are held already, or it has uncommitted changes.
+// Returns the bytes moved, or -1.
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  int tot;
+  uint off, m;
+  char *page;
+  struct buf *b;
+
+  if(in->readable == 0 || in->type != FD_INODE)
+    return -1;
+  if(out->writable == 0 || out->type != FD_PIPE)
+    return -1;
+
+  for(tot = 0; tot < n; tot += m){
+    ilock(in->ip);
+    if(in->off >= in->ip->size){
+      iunlock(in->ip);
+      break;
+    }
+    off = in->off % sb.bsize;
+    m = min(n - tot, sb.bsize - off);
+    m = min(m, in->ip->size - in->off);
+    page = 0;
+    if((b = iblock(in->ip, in->off, m)) != 0 && bhold(b)){
+      brelse(b);
+    } else {
+      if((page = kalloc()) == 0){
+        if(b)
+          brelse(b);
+        iunlock(in->ip);
+        break;
+      }
+      if(b){
+        memmove(page, b->data + off, m);
+        brelse(b);
+        b = 0;
+      } else {
+        memset(page, 0, m);
+      }
+    }
+    // Claim the bytes while the inode is locked, as fileread()
+    // does; if the pipe has no reader they are lost, as with
+    // a write().
+    in->off += m;
+    iunlock(in->ip);
+
+    if(b ? pipesplice(out->pipe, b, (char*)b->data, off, m) < 0
+         : pipesplice(out->pipe, 0, page, 0, m) < 0)
+      return tot > 0 ? tot : -1;
+  }
+  return tot;
+}
@@ -22,11 +22,19 @@ struct inode {
   int valid;          // inode has been read from disk?
 
   short type;         // copy of disk inode
-  short major;
+  short major;        // T_DEVICE: major device; T_DIR: DIRFMT_*
   short minor;
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
+
+  uint ranext;        // read-ahead: next block of a sequential reader
+  uint raend;         // read-ahead: blocks before this have been requested
+  uint rawin;         // read-ahead: window size in blocks, 0 if not sequential
+
+  struct inode *hnext; // itable hash chain
+  struct inode *prev;  // itable LRU list, while ref == 0
+  struct inode *next;
 };
 
 // map major device number to device functions.
@@ -26,7 +26,8 @@
 // only one device
 struct superblock sb; 
 
-// Read the super block.
+// Read the super block, which is at byte offset BSIZE: block 1
+// while the buffer cache still uses its initial BSIZE blocks.
 static void
 readsb(int dev, struct superblock *sb)
 {
@@ -35,15 +36,33 @@ readsb(int dev, struct superblock *sb)
   bp = bread(dev, 1);
   memmove(sb, bp->data, sizeof(*sb));
   brelse(bp);
+  if(sb->bsize == 0)  // made before the block size was recorded
+    sb->bsize = BSIZE;
 }
 
+static void bsuminit(int dev);
+
 // Init fs
 void
 fsinit(int dev) {
   readsb(dev, &sb);
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
+  if(sb.bsize < BSIZE || sb.bsize > MAXBSIZE || sb.bsize % BSIZE != 0)
+    panic("invalid block size");
+  bsetsize(sb.bsize);
   initlog(dev, &sb);
+  bsuminit(dev);
+}
+
+// Is block bno one of the n in held?
+static int
+isheld(uint *held, int n, uint bno)
+{
+  while(n-- > 0)
+    if(held[n] == bno)
+      return 1;
+  return 0;
 }
 
 // Zero a block.
@@ -53,35 +72,115 @@ bzero(int dev, int bno)
   struct buf *bp;
 
   bp = bread(dev, bno);
-  memset(bp->data, 0, BSIZE);
+  memset(bp->data, 0, sb.bsize);
   log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
+//
+// bsum summarizes the free bitmap in memory: how many free
+// blocks each bitmap block covers, so balloc() can skip full
+// bitmap blocks without reading them, and a next-fit cursor
+// where the last allocation ended. Callers pass a goal block,
+// normally the one after the file's previous block, so a file
+// that grows sequentially gets contiguous blocks. The counts
+// are updated while holding the bitmap block's buffer, under
+// bsum.lock; readers use them only as a hint.
 
-// Allocate a zeroed disk block.
-// returns 0 if out of disk space.
+struct {
+  struct spinlock lock;
+  uint nfree[FSSIZE/(BSIZE*8) + 1]; // free blocks per bitmap block
+  uint cursor;                // default goal
+} bsum;
+
+// Count the free blocks covered by each bitmap block.
+static void
+bsuminit(int dev)
+{
+  uint b, bi, n;
+  struct buf *bp;
+
+  initlock(&bsum.lock, "bsum");
+  if(sb.size > NELEM(bsum.nfree)*BPB(sb))
+    panic("bsuminit: file system too large");
+  for(b = 0; b < sb.size; b += BPB(sb)){
+    bp = bread(dev, BBLOCK(b, sb));
+    n = 0;
+    for(bi = 0; bi < BPB(sb) && b + bi < sb.size; bi++)
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        n++;
+    brelse(bp);
+    bsum.nfree[b / BPB(sb)] = n;
+  }
+  bsum.cursor = 0;
+}
+
+// Allocate a run of between 1 and want contiguous disk blocks,
+// as close after goal as possible (goal 0: no preference).
+// Sets *got to the length of the run and returns its first
+// block, or returns 0 if out of disk space. The blocks are
+// zeroed if zero is set; otherwise the caller must overwrite
+// them before anything can read them.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal, uint want, uint *got, int zero)
 {
-  int b, bi, m;
+  uint b, bi, i, n, nbmap, start;
+  uint held[NBUF];
+  int nheld;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
+  if(goal == 0 || goal >= sb.size)
+    goal = bsum.cursor;
+  nbmap = (sb.size + BPB(sb) - 1) / BPB(sb);
+
+  // Visit the goal's bitmap block twice: first from the goal
+  // to its end, and last from its start up to the goal.
+  for(i = 0; i <= nbmap; i++){
+    b = ((goal / BPB(sb) + i) % nbmap) * BPB(sb);
+    acquire(&bsum.lock);
+    n = bsum.nfree[b / BPB(sb)];
+    release(&bsum.lock);
+    if(n == 0)
+      continue;
+
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+    nheld = bheld(dev, b, b + BPB(sb), held, NBUF);
+    bi = (i == 0) ? goal % BPB(sb) : 0;
+    while(bi < BPB(sb) && b + bi < sb.size){
+      if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+        bi += 8;  // skip a full byte
+        continue;
       }
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0 &&  // Is block free?
+         !isheld(held, nheld, b + bi))  // and not still queued in a pipe?
+        break;
+      bi++;
+    }
+    if(bi >= BPB(sb) || b + bi >= sb.size){
+      brelse(bp);
+      continue;
+    }
+
+    // Mark the run in use.
+    start = bi;
+    for(n = 0; n < want && bi < BPB(sb) && b + bi < sb.size; n++, bi++){
+      if((bp->data[bi/8] & (1 << (bi % 8))) || isheld(held, nheld, b + bi))
+        break;
+      bp->data[bi/8] |= (1 << (bi % 8));
     }
+    log_write(bp);
+    acquire(&bsum.lock);
+    bsum.nfree[b / BPB(sb)] -= n;
+    bsum.cursor = b + bi;
+    release(&bsum.lock);
     brelse(bp);
+
+    if(zero)
+      for(i = 0; i < n; i++)
+        bzero(dev, b + start + i);
+    *got = n;
+    return b + start;
   }
   printf("balloc: out of blocks\n");
   return 0;
@@ -95,12 +194,15 @@ bfree(int dev, uint b)
   int bi, m;
 
   bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
+  bi = b % BPB(sb);
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  acquire(&bsum.lock);
+  bsum.nfree[b / BPB(sb)]++;
+  release(&bsum.lock);
   brelse(bp);
 }
 
@@ -130,17 +232,20 @@ bfree(int dev, uint b)
 //   the reference and link counts have fallen to zero.
 //
 // * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
+//   can be recycled if ip->ref is zero. Otherwise ip->ref
+//   tracks the number of in-memory pointers to the entry
+//   (open files and current directories). iget() finds or
 //   creates a table entry and increments its ref; iput()
 //   decrements ref.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   table entry is only correct when ip->valid is 1.
-//   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ilock() reads the inode from the disk and sets
+//   ip->valid. An entry whose ref has fallen to zero keeps
+//   its contents, so a later iget() of the same inode does
+//   not have to read it again; iget() clears ip->valid when
+//   it recycles the entry for a different inode, and iput()
+//   clears it when it frees the inode on disk.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -164,10 +269,17 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
+// The table starts with NINODE entries and grows a page at
+// a time, up to a limit set at boot from the amount of free
+// memory. Entries are found through a hash on (dev, inum);
+// entries with ref zero sit on an LRU list and the least
+// recently used one is recycled when the table may not grow.
+//
 // The itable.lock spin-lock protects the allocation of itable
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// holds, one must hold itable.lock while using any of those fields,
+// or the hash and LRU links.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -176,21 +288,97 @@ bfree(int dev, uint b)
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+
+  // Linked list of entries with ref == 0, through prev/next.
+  // lru.next is most recently released, lru.prev is least.
+  struct inode lru;
+
+  int n;    // number of entries, including inode[]
+  int max;  // the table does not grow past this
 } itable;
 
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+
+// Put ip on the LRU list: at the most recently used end,
+// or at the other end if its contents are of no further use.
+static void
+lruinsert(struct inode *ip, int recent)
+{
+  if(recent){
+    ip->next = itable.lru.next;
+    ip->prev = &itable.lru;
+  } else {
+    ip->next = &itable.lru;
+    ip->prev = itable.lru.prev;
+  }
+  ip->next->prev = ip;
+  ip->prev->next = ip;
+}
+
+static void
+lruremove(struct inode *ip)
+{
+  ip->next->prev = ip->prev;
+  ip->prev->next = ip->next;
+}
+
+static void
+hashremove(struct inode *ip)
+{
+  struct inode **pp;
+
+  for(pp = &itable.hash[IHASH(ip->dev, ip->inum)]; *pp; pp = &(*pp)->hnext){
+    if(*pp == ip){
+      *pp = ip->hnext;
+      return;
+    }
+  }
+  panic("hashremove");
+}
+
+// Add a page worth of fresh entries to the LRU list.
+// Returns 0 if the table is at its limit or out of memory.
+static int
+igrow(void)
+{
+  struct inode *ip, *page;
+
+  if(itable.n + PGSIZE/sizeof(struct inode) > itable.max)
+    return 0;
+  if((page = kalloc()) == 0)
+    return 0;
+  memset(page, 0, PGSIZE);
+  for(ip = page; ip < page + PGSIZE/sizeof(struct inode); ip++){
+    initsleeplock(&ip->lock, "inode");
+    lruinsert(ip, 0);
+    itable.n++;
+  }
+  return 1;
+}
+
 void
 iinit()
 {
   int i = 0;
   
   initlock(&itable.lock, "itable");
+  itable.lru.prev = &itable.lru;
+  itable.lru.next = &itable.lru;
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
+    lruinsert(&itable.inode[i], 0);
   }
+  itable.n = NINODE;
+  itable.max = NINODE + kfreecount() / IMEMFRAC * (PGSIZE/sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
 
+// Where ialloc() starts looking for a free inode. Only a hint:
+// the scan still wraps around and visits every inode.
+static uint inodehint = 1;
+
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode,
@@ -198,18 +386,20 @@ static struct inode* iget(uint dev, uint inum);
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  int i, inum;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  for(i = 1; i < sb.ninodes; i++){
+    inum = 1 + (inodehint - 1 + i - 1) % (sb.ninodes - 1);
     bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
+    dip = (struct dinode*)bp->data + inum%IPB(sb);
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
+      inodehint = inum + 1 < sb.ninodes ? inum + 1 : 1;
       return iget(dev, inum);
     }
     brelse(bp);
@@ -229,7 +419,7 @@ iupdate(struct inode *ip)
   struct dinode *dip;
 
   bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  dip = (struct dinode*)bp->data + ip->inum%IPB(sb);
   dip->type = ip->type;
   dip->major = ip->major;
   dip->minor = ip->minor;
@@ -246,31 +436,35 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = itable.hash[IHASH(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        lruremove(ip);
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Recycle the least recently used unreferenced entry,
+  // unless there is room to grow the table first.
+  if(itable.lru.prev == &itable.lru && igrow() == 0)
     panic("iget: no inodes");
 
-  ip = empty;
+  ip = itable.lru.prev;
+  lruremove(ip);
+  if(ip->inum != 0)
+    hashremove(ip);
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = itable.hash[IHASH(dev, inum)];
+  itable.hash[IHASH(dev, inum)] = ip;
   release(&itable.lock);
 
   return ip;
@@ -302,7 +496,7 @@ ilock(struct inode *ip)
 
   if(ip->valid == 0){
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-    dip = (struct dinode*)bp->data + ip->inum%IPB;
+    dip = (struct dinode*)bp->data + ip->inum%IPB(sb);
     ip->type = dip->type;
     ip->major = dip->major;
     ip->minor = dip->minor;
@@ -310,6 +504,7 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->ranext = ip->raend = ip->rawin = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -357,7 +552,8 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref == 0)
+    lruinsert(ip, ip->valid);
   release(&itable.lock);
 }
 
@@ -373,33 +569,68 @@ iunlockput(struct inode *ip)
 //
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
+// are listed in ip->addrs[].  The next NINDIRECT(sb) blocks are
 // listed in block ip->addrs[NDIRECT].
 
+// Return the disk block address of the nth block in inode ip,
+// or 0 if that block has not been allocated.
+static uint
+bmaplookup(struct inode *ip, uint bn)
+{
+  uint addr;
+  struct buf *bp;
+
+  if(bn < NDIRECT)
+    return ip->addrs[bn];
+  bn -= NDIRECT;
+
+  if(bn < NINDIRECT(sb)){
+    if(ip->addrs[NDIRECT] == 0)
+      return 0;
+    bp = bread(ip->dev, ip->addrs[NDIRECT]);
+    addr = ((uint*)bp->data)[bn];
+    brelse(bp);
+    return addr;
+  }
+
+  panic("bmaplookup: out of range");
+}
+
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one, placed right
+// after the file's previous block when that block is free.
+// If n is 0 a new block is zeroed. Otherwise the caller is
+// about to write blocks bn..bn+n-1 and never exposes what they
+// held before (writei() only writes below or at the end of the
+// file), so new blocks are not zeroed, and the missing ones in
+// that range are allocated together as one contiguous run.
 // returns 0 if out of disk space.
 static uint
-bmap(struct inode *ip, uint bn)
+bmap(struct inode *ip, uint bn, uint n)
 {
-  uint addr, *a;
+  uint addr, *a, i, got, prev;
   struct buf *bp;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0){
-      addr = balloc(ip->dev);
+      for(i = 1; i < n && bn + i < NDIRECT && ip->addrs[bn + i] == 0; i++)
+        ;
+      prev = bn > 0 ? ip->addrs[bn - 1] : 0;
+      addr = balloc(ip->dev, prev ? prev + 1 : 0, i, &got, n == 0);
       if(addr == 0)
         return 0;
-      ip->addrs[bn] = addr;
+      for(i = 0; i < got; i++)
+        ip->addrs[bn + i] = addr + i;
     }
     return addr;
   }
   bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
+  if(bn < NINDIRECT(sb)){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0){
-      addr = balloc(ip->dev);
+      prev = ip->addrs[NDIRECT - 1];
+      addr = balloc(ip->dev, prev ? prev + 1 : 0, 1, &got, 1);
       if(addr == 0)
         return 0;
       ip->addrs[NDIRECT] = addr;
@@ -407,9 +638,13 @@ bmap(struct inode *ip, uint bn)
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      addr = balloc(ip->dev);
+      for(i = 1; i < n && bn + i < NINDIRECT(sb) && a[bn + i] == 0; i++)
+        ;
+      prev = bn > 0 ? a[bn - 1] : ip->addrs[NDIRECT];
+      addr = balloc(ip->dev, prev ? prev + 1 : 0, i, &got, n == 0);
       if(addr){
-        a[bn] = addr;
+        for(i = 0; i < got; i++)
+          a[bn + i] = addr + i;
         log_write(bp);
       }
     }
@@ -439,7 +674,7 @@ itrunc(struct inode *ip)
   if(ip->addrs[NDIRECT]){
     bp = bread(ip->dev, ip->addrs[NDIRECT]);
     a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
+    for(j = 0; j < NINDIRECT(sb); j++){
       if(a[j])
         bfree(ip->dev, a[j]);
     }
@@ -462,15 +697,53 @@ stati(struct inode *ip, struct stat *st)
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+  st->blksize = sb.bsize;
+}
+
+// Sequential read-ahead.
+// A read that starts in the block where the previous read of
+// ip ended, or in the block after it, is sequential: it doubles
+// the read-ahead window, up to MAXREADAHEAD, and starts
+// asynchronous reads of the blocks in the window that have not
+// been requested yet. Any other read closes the window.
+// Caller must hold ip->lock.
+static void
+readahead(struct inode *ip, uint off, uint n)
+{
+  uint first, last, bn, end, addr;
+
+  first = off / sb.bsize;
+  last = (off + n - 1) / sb.bsize;
+
+  if(first + 1 == ip->ranext || first == ip->ranext){
+    ip->rawin = ip->rawin ? min(ip->rawin * 2, MAXREADAHEAD) : 2;
+  } else {
+    ip->rawin = 0;
+    ip->raend = 0;
+  }
+  ip->ranext = last + 1;
+  if(ip->rawin == 0)
+    return;
+
+  end = min(last + 1 + ip->rawin, (ip->size + sb.bsize - 1) / sb.bsize);
+  for(bn = ip->raend > last + 1 ? ip->raend : last + 1; bn < end; bn++){
+    if((addr = bmaplookup(ip, bn)) != 0)
+      breadahead(ip->dev, addr);
+  }
+  if(end > ip->raend)
+    ip->raend = end;
 }
 
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
+// Unallocated blocks (the empty buckets of a hashed
+// directory) read as zeroes.
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
+  static char zeroes[MAXBSIZE];
   uint tot, m;
   struct buf *bp;
 
@@ -478,14 +751,21 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
+  if(n > 0)
+    readahead(ip, off, n);
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
-      break;
+    uint addr = bmaplookup(ip, off/sb.bsize);
+    m = min(n - tot, sb.bsize - off%sb.bsize);
+    if(addr == 0){
+      if(either_copyout(user_dst, dst, zeroes, m) == -1) {
+        tot = -1;
+        break;
+      }
+      continue;
+    }
     bp = bread(ip->dev, addr);
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
+    if(either_copyout(user_dst, dst, bp->data + (off % sb.bsize), m) == -1) {
       brelse(bp);
       tot = -1;
       break;
@@ -495,6 +775,22 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Return a locked buf holding the block of ip that contains
+// byte off, or 0 if that block was never written. n is the
+// length of the read, for read-ahead. Caller must hold ip->lock.
+struct buf*
+iblock(struct inode *ip, uint off, uint n)
+{
+  uint addr;
+
+  if(off >= ip->size)
+    return 0;
+  readahead(ip, off, n);
+  if((addr = bmaplookup(ip, off / sb.bsize)) == 0)
+    return 0;
+  return bread(ip->dev, addr);
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -510,16 +806,16 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(off + n > MAXFILE(sb)*sb.bsize)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    uint addr = bmap(ip, off/BSIZE);
+    uint addr = bmap(ip, off/sb.bsize, (off + n - tot - 1)/sb.bsize - off/sb.bsize + 1);
     if(addr == 0)
       break;
-    bp = bread(ip->dev, addr);
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+    bp = bunshare(bread(ip->dev, addr));  // a pipe may hold it
+    m = min(n - tot, sb.bsize - off%sb.bsize);
+    if(either_copyin(bp->data + (off % sb.bsize), user_src, src, m) == -1) {
       brelse(bp);
       break;
     }
@@ -546,6 +842,105 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Hashed directories.
+//
+// A T_DIR inode whose major field is DIRFMT_HASHED keeps its
+// entries in DIRHASH_NBUCKETS one-block buckets instead of a
+// flat array, so lookup and create read one block no matter
+// how large the directory gets. An entry lives in bucket
+// dirhash(name) % DIRHASH_NBUCKETS or, if that block was full
+// when the entry was added, in the next bucket with room.
+// Buckets are allocated on first use, so the directory is a
+// sparse file and an unallocated bucket has never held an entry.
+//
+// Unlinking leaves a tombstone (inum 0, name[0] == DIRTOMB)
+// rather than a zeroed slot, so a bucket that has ever been
+// full never shows a never-used slot again and a lookup can
+// stop at the first bucket that does.
+
+// FNV-1a hash of a directory entry name.
+// mkfs.c has a copy; the two must agree.
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+static struct inode*
+hdirlookup(struct inode *dp, char *name, uint *poff)
+{
+  uint h, i, j, bn, addr, inum;
+  int unused;
+  struct buf *bp;
+  struct dirent *de;
+
+  h = dirhash(name);
+  for(i = 0; i < DIRHASH_NBUCKETS; i++){
+    bn = (h + i) % DIRHASH_NBUCKETS;
+    if((addr = bmaplookup(dp, bn)) == 0)
+      return 0;
+    bp = bread(dp->dev, addr);
+    de = (struct dirent*)bp->data;
+    unused = 0;
+    for(j = 0; j < DPB(sb); j++){
+      if(de[j].inum == 0){
+        if(de[j].name[0] == 0)
+          unused = 1;
+        continue;
+      }
+      if(namecmp(name, de[j].name) == 0){
+        if(poff)
+          *poff = bn*sb.bsize + j*sizeof(*de);
+        inum = de[j].inum;
+        brelse(bp);
+        return iget(dp->dev, inum);
+      }
+    }
+    brelse(bp);
+    if(unused)
+      return 0;
+  }
+  return 0;
+}
+
+static int
+hdirlink(struct inode *dp, char *name, uint inum)
+{
+  uint h, i, j, bn, addr;
+  struct buf *bp;
+  struct dirent *de;
+
+  h = dirhash(name);
+  for(i = 0; i < DIRHASH_NBUCKETS; i++){
+    bn = (h + i) % DIRHASH_NBUCKETS;
+    if((addr = bmap(dp, bn, 0)) == 0)
+      return -1;
+    bp = bread(dp->dev, addr);
+    de = (struct dirent*)bp->data;
+    for(j = 0; j < DPB(sb); j++){
+      if(de[j].inum == 0){
+        strncpy(de[j].name, name, DIRSIZ);
+        de[j].inum = inum;
+        log_write(bp);
+        brelse(bp);
+        // bmap() may have added a bucket to dp->addrs[].
+        iupdate(dp);
+        return 0;
+      }
+    }
+    brelse(bp);
+  }
+  return -1;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
@@ -557,6 +952,9 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dp->major == DIRFMT_HASHED)
+    return hdirlookup(dp, name, poff);
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -589,6 +987,9 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if(dp->major == DIRFMT_HASHED)
+    return hdirlink(dp, name, inum);
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -3,14 +3,17 @@
 
 
 #define ROOTINO  1   // root i-number
-#define BSIZE 1024  // block size
+#define BSIZE 1024  // smallest (and default) block size
+#define MAXBSIZE 4096  // largest block size
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
 //                                          free bit map | data blocks]
 //
 // mkfs computes the super block and builds an initial file system. The
-// super block describes the disk layout:
+// super block describes the disk layout. It is always at byte offset
+// BSIZE on the disk, so it can be read before the block size is known;
+// with larger blocks it sits inside the boot block and block 1 is unused.
 struct superblock {
   uint magic;        // Must be FSMAGIC
   uint size;         // Size of file system image (blocks)
@@ -23,18 +26,22 @@ struct superblock {
 
   uint nswap;        /* Adil: Number of swap blocks */
   uint swapstart;    /* Adil: Block number of first swap block */
+  uint bsize;        // Block size in bytes: BSIZE, 2*BSIZE or 4*BSIZE
 };
 
 #define FSMAGIC 0x10203040
 
+// The macros below that take sb describe the file system with
+// super block sb, whose block size is sb.bsize.
+
 #define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NINDIRECT(sb) ((sb).bsize / sizeof(uint))
+#define MAXFILE(sb) (NDIRECT + NINDIRECT(sb))
 
 // On-disk inode structure
 struct dinode {
   short type;           // File type
-  short major;          // Major device number (T_DEVICE only)
+  short major;          // T_DEVICE: major device number; T_DIR: DIRFMT_*
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
@@ -42,16 +49,16 @@ struct dinode {
 };
 
 // Inodes per block.
-#define IPB           (BSIZE / sizeof(struct dinode))
+#define IPB(sb)           ((sb).bsize / sizeof(struct dinode))
 
 // Block containing inode i
-#define IBLOCK(i, sb)     ((i) / IPB + sb.inodestart)
+#define IBLOCK(i, sb)     ((i) / IPB(sb) + (sb).inodestart)
 
 // Bitmap bits per block
-#define BPB           (BSIZE*8)
+#define BPB(sb)           ((sb).bsize*8)
 
 // Block of free map containing bit for block b
-#define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
+#define BBLOCK(b, sb) ((b)/BPB(sb) + (sb).bmapstart)
 
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
@@ -61,3 +68,16 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Directory entries per block.
+#define DPB(sb)           ((sb).bsize / sizeof(struct dirent))
+
+// Directory formats, kept in the major field of a T_DIR inode.
+#define DIRFMT_LINEAR    0   // flat array of dirents, searched in order
+#define DIRFMT_HASHED    1   // one-block hash buckets, see fs.c
+
+// A hashed directory is a sparse file of DIRHASH_NBUCKETS blocks.
+#define DIRHASH_NBUCKETS 256
+
+// Name of a deleted entry in a hashed directory (inum is 0).
+#define DIRTOMB       0x7f
+
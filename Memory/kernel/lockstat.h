@@ -0,0 +1,12 @@
+// Spinlock statistics, gathered per lock name: all locks
+// initialized with the same name, such as every "proc" lock,
+// share one entry. The lockstat() system call reads them.
+// Both the kernel and user programs use this header file.
+
+struct lockstat {
+  char name[16];
+  uint64 acquires;   // times acquired
+  uint64 contended;  // acquires that had to wait
+  uint64 spin;       // time CSR units spent waiting
+  uint64 maxhold;    // longest time held
+};
@@ -1,22 +1,29 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define NWAITQ       64  // sleep/wakeup channel hash buckets
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // i-nodes in the table at boot; it grows on demand
+#define NIHASH       64  // i-node table hash buckets
+#define IMEMFRAC     64  // i-node table may use 1/IMEMFRAC of free memory
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define MAXREADAHEAD 8   // max blocks of sequential read-ahead per file
+#define NBUF         (MAXOPBLOCKS*3 + MAXREADAHEAD*2)  // size of disk block cache
 // #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
-#define FSSIZE       6000  // size of file system in blocks
+#define NTRACE       1024  // events in each CPU's trace ring
+#define NLOCKSTAT    64    // lock names with statistics
+#define TIMEFREQ     10000000 // time CSR ticks per second in qemu
+#define TICKINTERVAL 1000000  // time units between scheduler ticks; 1/10th second
+#define FSSIZE       10000 // size of file system in BSIZE blocks, PSA included
 
-/* CSE 536: changed to 3000 to use the last 1000 blocks for page swapping. */
-#define PSASTART                33       // Starting page save area (PSA) block
-#define PSAEND                  4032     // Ending page save area (PSA) block
-#define PSASIZE                 4000     // total size of the PSA
+/* CSE 536: the page save area (PSA) is part of fs.img. It starts at
+   sb.swapstart, right after the log, and is counted in FSSIZE. */
+#define PSASIZE                 4000     // total size of the PSA, in BSIZE blocks
 
 /* CSE 536: heap-related definitions. */
 #define MAXHEAP                 1000     // maximum pages for heap allocation
@@ -5,6 +5,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "seqlock.h"
 #include "defs.h"
 #include "elf.h"
 
@@ -18,13 +19,18 @@ int flags2perm(int flags);
 /* Read current time. */
 uint64 read_current_timestamp() {
   uint64 curticks = 0;
-  acquire(&tickslock);
-  curticks = ticks;
-  wakeup(&ticks);
-  release(&tickslock);
+  uint s;
+  do {
+    s = readseqbegin(&tickslock);
+    curticks = ticks;
+  } while(readseqretry(&tickslock, s));
   return curticks;
 }
 
+/* PSA blocks per page. The PSA starts at sb.swapstart. */
+#define PSABPP (PGSIZE / sb.bsize)
+
+/* In-use PSA blocks, relative to sb.swapstart. */
 bool psa_tracker[PSASIZE];
 
 /* All blocks are free during initialization. */
@@ -38,13 +44,13 @@ void init_psa_regions(void)
 void evict_page_to_disk(struct proc* p) {
     /* Find free block */
     int blockno = 0;
-    for (int block = PSASTART; block < PSAEND - 3; block += 4) {
+    for (int block = 0; block + PSABPP <= sb.nswap; block += PSABPP) {
       if (!psa_tracker[block]) {
         blockno = block;
 	break;
       }
     }
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < PSABPP; i++) {
       psa_tracker[blockno + i] = true;
     }
 
@@ -61,7 +67,7 @@ void evict_page_to_disk(struct proc* p) {
     uint64 victim_addr = p->heap_tracker[oldest_idx].addr;
 
     /* Print statement. */
-    print_evict_page(victim_addr, blockno - PSASTART);
+    print_evict_page(victim_addr, blockno);
     p->heap_tracker[oldest_idx].loaded = false;
     p->heap_tracker[oldest_idx].startblock = blockno;
 
@@ -71,10 +77,10 @@ void evict_page_to_disk(struct proc* p) {
 
     /* Write to the disk blocks. */
     struct buf* b;
-    for (int i = 0; i < 4; i++) {
-      b = bread(1, PSASTART + (blockno + i));
+    for (int i = 0; i < PSABPP; i++) {
+      b = bread(1, sb.swapstart + (blockno + i));
       // Copy page contents to b.data using memmove.
-      memmove(b->data, kpage + i*BSIZE, BSIZE);
+      memmove(b->data, kpage + i*sb.bsize, sb.bsize);
       bwrite(b);
       brelse(b);
     }
@@ -106,15 +112,15 @@ void retrieve_page_from_disk(struct proc* p, uint64 uvaddr) {
     int startblock = p->heap_tracker[page_idx].startblock;
 
     /* Print statement. */
-    print_retrieve_page(uvaddr, startblock - PSASTART);
+    print_retrieve_page(uvaddr, startblock);
 
     /* Create a kernel page to read memory temporarily into first. */
     char *kpage = kalloc();
 
     /* Read the disk block into temp kernel page. */
-    for (int i = 0; i < 4; i++) {
-      struct buf* b = bread(1, PSASTART + startblock + i);
-      memmove(kpage + i*BSIZE, b->data, BSIZE);
+    for (int i = 0; i < PSABPP; i++) {
+      struct buf* b = bread(1, sb.swapstart + startblock + i);
+      memmove(kpage + i*sb.bsize, b->data, sb.bsize);
       brelse(b);
     }
 
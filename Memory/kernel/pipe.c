@@ -8,17 +8,113 @@
 #include "sleeplock.h"
 #include "file.h"
 
-#define PIPESIZE 512
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// A pipe is a FIFO of up to PIPEMAXPAGES buffers, each a run of
+// bytes within one page or disk block. write() copies into pages
+// the pipe allocates; splice() and vmsplice() instead queue a
+// reference to a held buffer-cache block or to a user page.
+// Capacity is counted in queued bytes, as for a ring; the
+// number of buffers is only an internal bound.
+#define PIPESIZE     PGSIZE        // default capacity
+#define PIPEMAXPAGES 16            // largest capacity, in pages
+
+struct pipebuf {
+  char *data;     // the page or block
+  uint off;       // first unread byte
+  uint len;       // unread bytes
+  int own;        // page allocated by the pipe; write() may append
+  struct buf *b;  // block held by bhold(), or 0 for a page
+};
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  struct pipebuf bufs[PIPEMAXPAGES];
+  uint head;      // first buffer, mod PIPEMAXPAGES
+  uint nbuf;      // buffers in use
+  uint size;      // capacity, in bytes
+  char *spare;    // a free page kept for the next write
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
 };
 
+// Drop the first buffer.
+static void
+pipepop(struct pipe *pi)
+{
+  struct pipebuf *pb;
+
+  pb = &pi->bufs[pi->head % PIPEMAXPAGES];
+  if(pb->b)
+    bunhold(pb->b);
+  else if(pb->own && pi->spare == 0)
+    pi->spare = pb->data;
+  else
+    kfree(pb->data);
+  pb->data = 0;
+  pb->b = 0;
+  pi->head++;
+  pi->nbuf--;
+}
+
+// Append a buffer; the caller has checked there is room.
+static struct pipebuf*
+pipepush(struct pipe *pi, char *data, uint off, uint len, int own, struct buf *b)
+{
+  struct pipebuf *pb;
+
+  pb = &pi->bufs[(pi->head + pi->nbuf++) % PIPEMAXPAGES];
+  pb->data = data;
+  pb->off = off;
+  pb->len = len;
+  pb->own = own;
+  pb->b = b;
+  pi->nwrite += len;
+  return pb;
+}
+
+// Bytes that can be queued before the pipe is full.
+static uint
+piperoom(struct pipe *pi)
+{
+  uint used = pi->nwrite - pi->nread;
+
+  return used < pi->size ? pi->size - used : 0;
+}
+
+// Wait until n more bytes fit (or the pipe is empty, if n is
+// more than the capacity) and, if slot is set, another buffer
+// can be appended.
+// Returns -1 if the pipe has no reader or we were killed.
+static int
+pipewait(struct pipe *pi, uint n, int slot)
+{
+  struct proc *pr = myproc();
+
+  n = min(n, pi->size);
+  while(piperoom(pi) < n || (slot && pi->nbuf == PIPEMAXPAGES)){  //DOC: pipewrite-full
+    if(pi->readopen == 0 || killed(pr))
+      return -1;
+    wakeup(&pi->nread);
+    sleep(&pi->nwrite, &pi->lock);
+  }
+  if(pi->readopen == 0 || killed(pr))
+    return -1;
+  return 0;
+}
+
+static void
+pipefree(struct pipe *pi)
+{
+  while(pi->nbuf > 0)
+    pipepop(pi);
+  if(pi->spare)
+    kfree(pi->spare);
+  kfree((char*)pi);
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -30,6 +126,8 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(pi, 0, sizeof(*pi));
+  pi->size = PIPESIZE;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
@@ -47,7 +145,7 @@ pipealloc(struct file **f0, struct file **f1)
 
  bad:
   if(pi)
-    kfree((char*)pi);
+    pipefree(pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,37 +166,157 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    pipefree(pi);
   } else
     release(&pi->lock);
 }
 
+// Set the capacity to at least n bytes, rounded up to whole
+// pages. Fails if n is too large or more bytes are queued
+// than would fit. n == 0 leaves the capacity alone.
+// Returns the new capacity, or -1.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipesize(struct pipe *pi, int n)
 {
-  int i = 0;
-  struct proc *pr = myproc();
+  uint size;
+
+  if(n < 0 || n > PIPEMAXPAGES*PGSIZE)
+    return -1;
+  size = PGROUNDUP(n);
 
   acquire(&pi->lock);
-  while(i < n){
-    if(pi->readopen == 0 || killed(pr)){
+  if(n > 0){
+    if(pi->nwrite - pi->nread > size){
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
-      sleep(&pi->nwrite, &pi->lock);
-    } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    pi->size = size;
+    wakeup(&pi->nwrite);
+  }
+  size = pi->size;
+  release(&pi->lock);
+  return size;
+}
+
+// Copy n bytes from addr (a user address if user is set) into
+// pipe-owned pages, appending to the last one while it has
+// room, with one copy per contiguous span.
+// Caller holds pi->lock. Returns the bytes copied, or -1 if
+// none could be because the pipe has no reader or we were
+// killed.
+static int
+pipecopyin(struct pipe *pi, int user, uint64 addr, int n)
+{
+  int i = 0;
+  uint len;
+  char *page;
+  struct pipebuf *pb;
+
+  while(i < n){
+    if(pipewait(pi, 1, 0) < 0)
+      return i > 0 ? i : -1;
+    pb = 0;
+    if(pi->nbuf > 0){
+      pb = &pi->bufs[(pi->head + pi->nbuf - 1) % PIPEMAXPAGES];
+      if(!pb->own || pb->off + pb->len == PGSIZE)
+        pb = 0;
+    }
+    if(pb == 0){
+      // a new page; appending after a wait is just as good.
+      if(pipewait(pi, 1, 1) < 0)
+        return i > 0 ? i : -1;
+      if((page = pi->spare) != 0)
+        pi->spare = 0;
+      else if((page = kalloc()) == 0)
         break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      pb = pipepush(pi, page, 0, 0, 1, 0);
     }
+    len = min(PGSIZE - (pb->off + pb->len), n - i);
+    len = min(len, piperoom(pi));
+    if(either_copyin(pb->data + pb->off + pb->len, user, addr + i, len) == -1)
+      break;
+    pb->len += len;
+    pi->nwrite += len;
+    i += len;
+  }
+  return i;
+}
+
+int
+pipewrite(struct pipe *pi, uint64 addr, int n)
+{
+  int i;
+
+  acquire(&pi->lock);
+  i = pipecopyin(pi, 1, addr, n);
+  wakeup(&pi->nread);
+  release(&pi->lock);
+
+  return i;
+}
+
+// Queue n bytes at data + off by reference. data is the block
+// of buffer b, held by bhold(), or if b is 0 a page from kalloc().
+// The pipe takes over the hold or the page, even on failure.
+// Returns n, or -1.
+int
+pipesplice(struct pipe *pi, struct buf *b, char *data, uint off, uint n)
+{
+  acquire(&pi->lock);
+  if(pipewait(pi, n, 1) < 0){
+    release(&pi->lock);
+    if(b)
+      bunhold(b);
+    else
+      kfree(data);
+    return -1;
   }
+  pipepush(pi, data, off, n, b == 0, b);
   wakeup(&pi->nread);
   release(&pi->lock);
+  return n;
+}
+
+// Queue n bytes of user memory at addr. Whole resident pages
+// are shared with the pipe rather than copied, so the reader
+// sees the page as it is when read: the writer must not change
+// it until then. The rest is copied as by write().
+// Returns the bytes queued, or -1.
+int
+pipevmsplice(struct pipe *pi, uint64 addr, int n)
+{
+  int i, m, r;
+  uint64 pa;
+  struct proc *pr = myproc();
 
+  acquire(&pi->lock);
+  for(i = 0; i < n; i += m){
+    pa = 0;
+    if((addr + i) % PGSIZE == 0 && n - i >= PGSIZE)
+      pa = walkaddr(pr->pagetable, addr + i);
+    if(pa == 0){
+      // Copy up to the next page boundary.
+      m = min(PGSIZE - (addr + i) % PGSIZE, n - i);
+      if((r = pipecopyin(pi, 1, addr + i, m)) < 0){
+        release(&pi->lock);
+        return i > 0 ? i : -1;
+      }
+      if(r < m){
+        i += r;
+        break;
+      }
+      continue;
+    }
+    if(pipewait(pi, PGSIZE, 1) < 0){
+      release(&pi->lock);
+      return i > 0 ? i : -1;
+    }
+    kdup((void*)pa);
+    pipepush(pi, (char*)pa, 0, PGSIZE, 0, 0);
+    m = PGSIZE;
+  }
+  wakeup(&pi->nread);
+  release(&pi->lock);
   return i;
 }
 
@@ -106,8 +324,9 @@ int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
   int i;
+  uint len;
+  struct pipebuf *pb;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -117,12 +336,16 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  for(i = 0; i < n && pi->nbuf > 0; i += len){  //DOC: piperead-copy
+    pb = &pi->bufs[pi->head % PIPEMAXPAGES];
+    len = min(pb->len, n - i);
+    if(len > 0 && copyout(pr->pagetable, addr + i, pb->data + pb->off, len) == -1)
       break;
+    pb->off += len;
+    pb->len -= len;
+    pi->nread += len;
+    if(pb->len == 0)
+      pipepop(pi);
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
@@ -3,8 +3,10 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rwlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "sched.h"
 
 struct cpu cpus[NCPU];
 
@@ -26,6 +28,18 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// guards p->pid of every process, so that findproc() can
+// scan the table without taking each p->lock.
+// taken after p->lock by writers; readers hold no p->lock.
+struct rwlock pidtab_lock;
+
+// Sleeping processes, hashed by channel, so that wakeup()
+// only looks at processes sleeping on channels in one bucket.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitqs[NWAITQ];
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -48,9 +62,15 @@ void
 procinit(void)
 {
   struct proc *p;
+  int i;
+  
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initrwlock(&pidtab_lock, "pidtab");
+  for(i = 0; i < NWAITQ; i++)
+    initlock(&waitqs[i].lock, "waitq");
+  schedinit();
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -89,6 +109,15 @@ myproc(void)
   return p;
 }
 
+// Make p RUNNABLE and add it to its CPU's run queue.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  rqadd(p);
+}
+
 int
 allocpid()
 {
@@ -122,8 +151,15 @@ allocproc(void)
   return 0;
 
 found:
+  acquirewrite(&pidtab_lock);
   p->pid = allocpid();
+  releasewrite(&pidtab_lock);
   p->state = USED;
+  p->sclass = SCHED_FAIR;
+  p->prio = 0;
+  p->weight = FAIRWEIGHT;
+  p->vruntime = 0;
+  p->timeridx = -1;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -162,7 +198,9 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  acquirewrite(&pidtab_lock);
   p->pid = 0;
+  releasewrite(&pidtab_lock);
   p->parent = 0;
   p->name[0] = 0;
   p->chan = 0;
@@ -249,7 +287,8 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  p->cpu = cpuid();
+  setrunnable(p);
 
   release(&p->lock);
 }
@@ -336,6 +375,12 @@ fork(void)
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  // the child inherits the scheduling class.
+  np->sclass = p->sclass;
+  np->prio = p->prio;
+  np->weight = p->weight;
+  np->vruntime = p->vruntime;
+
   pid = np->pid;
 
   release(&np->lock);
@@ -345,7 +390,8 @@ fork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  np->cpu = cpuid();
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -463,7 +509,8 @@ wait(uint64 addr)
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - take the next process from this CPU's run queue,
+//    or steal one from another CPU's (see sched.c).
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -472,28 +519,35 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = c - cpus;
   
   c->proc = 0;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
+    if((p = rqtake(id)) == 0){
+      timeridle();
+      continue;
     }
+
+    acquire(&p->lock);
+    if(p->state == RUNNABLE) {
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      p->cpu = id;
+      p->runstart = r_time();
+      timertick();
+      c->proc = p;
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
+    }
+    release(&p->lock);
   }
 }
 
@@ -519,6 +573,12 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  // charge p for the time it ran, then requeue it if it
+  // is only yielding.
+  schedcharge(p);
+  if(p->state == RUNNABLE)
+    rqadd(p);
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -556,56 +616,124 @@ forkret(void)
   usertrapret();
 }
 
+static struct waitq*
+waitq(void *chan)
+{
+  return &waitqs[(((uint64)chan >> 3) * 2654435761U) % NWAITQ];
+}
+
+// Unlink p from wq. Caller holds wq->lock.
+static void
+waitqremove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &wq->head; *pp != p; pp = &(*pp)->wnext)
+    ;
+  *pp = p->wnext;
+  p->wnext = 0;
+  p->wq = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = waitq(chan);
+  int linked;
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once p is on chan's wait queue, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks the queue and then p->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
-  release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->wq = wq;
+  p->wnext = wq->head;
+  wq->head = p;
+  release(lk);
+  release(&wq->lock);
 
   /* Adil: sleeping. */
   // printf("Sleeping and yielding CPU.");
 
   sched();
 
-  // Tidy up.
+  // Tidy up. wakeup() unlinks p; kill() does not.
   p->chan = 0;
+  linked = p->wq != 0;
+  release(&p->lock);
+  if(linked){
+    acquire(&wq->lock);
+    waitqremove(wq, p);
+    release(&wq->lock);
+  }
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
 // Wake up all processes sleeping on chan.
-// Must be called without any p->lock.
+// Must be called without any p->lock, and with the lock
+// the sleepers passed to sleep() held.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  struct waitq *wq = waitq(chan);
+  struct proc *p, *next;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
+  // sleepers join the queue before releasing the lock
+  // our caller holds, so an empty queue can be skipped.
+  if(wq->head == 0)
+    return;
+
+  acquire(&wq->lock);
+  for(p = wq->head; p; p = next){
+    next = p->wnext;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      waitqremove(wq, p);
+      setrunnable(p);
     }
+    release(&p->lock);
   }
+  release(&wq->lock);
+}
+
+// Return the process with the given pid, with its lock held,
+// or 0 if there is none. The scan takes only a read lock on
+// pidtab_lock; p->lock is taken afterwards, so p is checked
+// again in case it exited meanwhile.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  acquireread(&pidtab_lock);
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->pid == pid)
+      break;
+  releaseread(&pidtab_lock);
+  if(p == &proc[NPROC])
+    return 0;
+
+  acquire(&p->lock);
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
 }
 
 // Kill the process with the given pid.
@@ -616,20 +744,44 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
+}
+
+// Set the scheduling class of the process with the given pid,
+// or of the caller if pid is 0. param is the SCHED_FAIR weight
+// or the SCHED_PRIO priority. Takes effect the next time the
+// process is queued to run.
+int
+setsched(int pid, int class, int param)
+{
+  struct proc *p;
+
+  if(class == SCHED_FAIR && (param < 1 || param > MAXWEIGHT))
+    return -1;
+  if(class == SCHED_PRIO && (param < 0 || param >= NPRIO))
+    return -1;
+  if(class != SCHED_FAIR && class != SCHED_PRIO)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->sclass = class;
+  if(class == SCHED_FAIR)
+    p->weight = param;
+  else
+    p->prio = param;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -27,6 +27,9 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 tickat;              // Time of next scheduler tick, or 0 if idle.
+  uint64 timerat;             // Time its CLINT compare is set for.
+  int idle;                   // Waiting in wfi for work?
 };
 
 extern struct cpu cpus[NCPU];
@@ -99,9 +102,19 @@ struct proc {
   // p->lock must be held when using these:
   enum procstate state;        // Process state
   void *chan;                  // If non-zero, sleeping on chan
+  struct waitq *wq;            // Wait queue p is on, or 0
+  struct proc *wnext;          // Next on that wait queue
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU it last ran on; its run queue
+  int sclass;                  // Scheduling class, SCHED_*
+  int prio;                    // SCHED_PRIO priority
+  int weight;                  // SCHED_FAIR weight
+  uint64 vruntime;             // SCHED_FAIR virtual runtime
+  uint64 runstart;             // When it last started running
+  uint64 wakeat;               // timersleep() deadline; timers.lock
+  int timeridx;                // Slot in the timer heap, or -1
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -116,6 +129,9 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 
+  // the run queue's lock must be held when using this:
+  struct proc *rqnext;         // Next process in run queue
+
   bool                    ondemand;
   struct heap_tracker_t   heap_tracker[MAXHEAP];
   int                     resident_heap_pages;
@@ -0,0 +1,63 @@
+// Reader-writer spin locks.
+// Like spinlocks, they disable interrupts while held.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "rwlock.h"
+#include "defs.h"
+
+void
+initrwlock(struct rwlock *lk, char *name)
+{
+  lk->name = name;
+  lk->n = 0;
+  lk->wwait = 0;
+}
+
+void
+acquireread(struct rwlock *lk)
+{
+  int n;
+
+  push_off();
+  for(;;){
+    n = *(volatile int*)&lk->n;
+    if(n >= 0 && *(volatile uint*)&lk->wwait == 0 &&
+       __sync_bool_compare_and_swap(&lk->n, n, n + 1))
+      break;
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwlock *lk)
+{
+  if(lk->n <= 0)
+    panic("releaseread");
+  __sync_synchronize();
+  __sync_fetch_and_sub(&lk->n, 1);
+  pop_off();
+}
+
+void
+acquirewrite(struct rwlock *lk)
+{
+  push_off();
+  __sync_fetch_and_add(&lk->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&lk->n, 0, -1))
+    ;
+  __sync_fetch_and_sub(&lk->wwait, 1);
+  __sync_synchronize();
+}
+
+void
+releasewrite(struct rwlock *lk)
+{
+  if(lk->n != -1)
+    panic("releasewrite");
+  __sync_synchronize();
+  __sync_fetch_and_add(&lk->n, 1);
+  pop_off();
+}
@@ -0,0 +1,10 @@
+// Reader-writer spin lock: many readers or one writer.
+// Waiting writers hold off new readers, so writers are not
+// starved by a stream of readers.
+struct rwlock {
+  int n;             // Readers holding it, or -1 if a writer is.
+  uint wwait;        // Writers waiting.
+
+  // For debugging:
+  char *name;        // Name of lock.
+};
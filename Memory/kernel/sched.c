@@ -0,0 +1,280 @@
+//
+// Per-CPU run queues and scheduling classes.
+//
+// Each CPU has a run queue holding one sub-queue per class.
+// A process joins the queue of the CPU it last ran on; a CPU
+// with nothing to run steals from the others. Classes are
+// tried in order of precedence, so any queued SCHED_PRIO
+// process runs before any SCHED_FAIR one.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "sched.h"
+
+#define NCLASS 2
+
+struct runq {
+  struct spinlock lock;
+  int n;                       // queued processes; may be read without the lock
+  int nclass[NCLASS];          // queued processes in each class
+
+  // SCHED_PRIO: a FIFO per priority.
+  struct proc *prio[NPRIO];
+  struct proc *priotail[NPRIO];
+
+  // SCHED_FAIR: sorted by virtual runtime.
+  struct proc *fair;
+  uint64 minvruntime;          // never decreases
+};
+
+struct runq runqs[NCPU];
+
+// A scheduling class. Called with the run queue's lock held.
+struct schedclass {
+  // add p to rq.
+  void (*enqueue)(struct runq *rq, struct proc *p);
+  // remove and return the process to run next, or 0.
+  struct proc *(*dequeue)(struct runq *rq);
+  // should running process p give way to a queued process
+  // of the same class? tick is set at a timer interrupt.
+  int (*preempt)(struct runq *rq, struct proc *p, int tick);
+  // p ran for ran time units.
+  void (*charge)(struct proc *p, uint64 ran);
+};
+
+// Virtual runtime p would have after running for ran units.
+static uint64
+vruntime(struct proc *p, uint64 ran)
+{
+  return p->vruntime + ran * FAIRWEIGHT / p->weight;
+}
+
+static void
+fairenqueue(struct runq *rq, struct proc *p)
+{
+  struct proc **pp;
+
+  // a process that slept or moved here must not get a burst
+  // of catch-up time ahead of the others.
+  if(p->vruntime < rq->minvruntime)
+    p->vruntime = rq->minvruntime;
+  for(pp = &rq->fair; *pp && (*pp)->vruntime <= p->vruntime; pp = &(*pp)->rqnext)
+    ;
+  p->rqnext = *pp;
+  *pp = p;
+}
+
+static struct proc*
+fairdequeue(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = rq->fair) == 0)
+    return 0;
+  rq->fair = p->rqnext;
+  if(p->vruntime > rq->minvruntime)
+    rq->minvruntime = p->vruntime;
+  return p;
+}
+
+static int
+fairpreempt(struct runq *rq, struct proc *p, int tick)
+{
+  return tick && rq->fair && rq->fair->vruntime < vruntime(p, r_time() - p->runstart);
+}
+
+static void
+faircharge(struct proc *p, uint64 ran)
+{
+  p->vruntime = vruntime(p, ran);
+}
+
+static void
+prioenqueue(struct runq *rq, struct proc *p)
+{
+  p->rqnext = 0;
+  if(rq->priotail[p->prio])
+    rq->priotail[p->prio]->rqnext = p;
+  else
+    rq->prio[p->prio] = p;
+  rq->priotail[p->prio] = p;
+}
+
+static struct proc*
+priodequeue(struct runq *rq)
+{
+  struct proc *p;
+  int i;
+
+  for(i = NPRIO-1; i >= 0; i--){
+    if((p = rq->prio[i]) != 0){
+      if((rq->prio[i] = p->rqnext) == 0)
+        rq->priotail[i] = 0;
+      return p;
+    }
+  }
+  return 0;
+}
+
+// A higher priority preempts at once; an equal one shares
+// the CPU round-robin, one tick at a time.
+static int
+priopreempt(struct runq *rq, struct proc *p, int tick)
+{
+  int i;
+
+  for(i = NPRIO-1; i > p->prio; i--)
+    if(rq->prio[i])
+      return 1;
+  return tick && rq->prio[p->prio];
+}
+
+static void
+priocharge(struct proc *p, uint64 ran)
+{
+}
+
+static struct schedclass classes[NCLASS] = {
+[SCHED_FAIR] { fairenqueue, fairdequeue, fairpreempt, faircharge },
+[SCHED_PRIO] { prioenqueue, priodequeue, priopreempt, priocharge },
+};
+
+// Classes from highest precedence to lowest.
+static int order[NCLASS] = { SCHED_PRIO, SCHED_FAIR };
+
+void
+schedinit(void)
+{
+  struct runq *rq;
+
+  for(rq = runqs; rq < &runqs[NCPU]; rq++)
+    initlock(&rq->lock, "runq");
+}
+
+// Idle CPUs take no ticks, so tell one about newly queued p:
+// its own CPU if idle, else any idle CPU that can steal p
+// from a busy one.
+static void
+rqkick(struct proc *p)
+{
+  struct cpu *c = &cpus[p->cpu];
+  int i;
+
+  __sync_synchronize();
+  if(c->idle){
+    timerkick(p->cpu);
+    return;
+  }
+  if(c->proc == p)  // p is giving up its CPU, which will run it
+    return;
+  for(i = 0; i < NCPU; i++){
+    if(cpus[i].idle){
+      timerkick(i);
+      return;
+    }
+  }
+}
+
+// Add p to its CPU's run queue.
+// Caller must hold p->lock.
+void
+rqadd(struct proc *p)
+{
+  struct runq *rq = &runqs[p->cpu];
+
+  acquire(&rq->lock);
+  classes[p->sclass].enqueue(rq, p);
+  rq->nclass[p->sclass]++;
+  rq->n++;
+  release(&rq->lock);
+  rqkick(p);
+}
+
+// Remove and return the next process on rq, or 0.
+static struct proc*
+rqpop(struct runq *rq)
+{
+  struct proc *p;
+  int i;
+
+  if(rq->n == 0)  // don't touch the lock of an empty queue
+    return 0;
+  p = 0;
+  acquire(&rq->lock);
+  for(i = 0; i < NCLASS; i++){
+    if((p = classes[order[i]].dequeue(rq)) != 0){
+      rq->nclass[order[i]]--;
+      rq->n--;
+      break;
+    }
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Return the next process for CPU id to run, taken from its
+// own run queue or stolen from another CPU's, or 0.
+struct proc*
+rqtake(int id)
+{
+  struct proc *p;
+  int i;
+
+  p = rqpop(&runqs[id]);
+  for(i = 1; p == 0 && i < NCPU; i++)
+    p = rqpop(&runqs[(id + i) % NCPU]);
+  return p;
+}
+
+// Are all run queues empty? Reads without locks.
+int
+rqempty(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    if(runqs[i].n > 0)
+      return 0;
+  return 1;
+}
+
+// p is about to stop running; charge it for the time it ran.
+// Caller must hold p->lock.
+void
+schedcharge(struct proc *p)
+{
+  classes[p->sclass].charge(p, r_time() - p->runstart);
+}
+
+// Should the current process give up the CPU to a queued one?
+// tick is set at a timer interrupt.
+int
+needresched(int tick)
+{
+  struct runq *rq;
+  struct proc *p;
+  int i, r;
+
+  push_off();
+  rq = &runqs[cpuid()];
+  p = mycpu()->proc;
+  r = 0;
+  if(p && rq->n > 0){
+    acquire(&rq->lock);
+    // any queued process of a higher class preempts p.
+    for(i = 0; order[i] != p->sclass; i++)
+      if(rq->nclass[order[i]] > 0)
+        r = 1;
+    if(!r)
+      r = classes[p->sclass].preempt(rq, p, tick);
+    release(&rq->lock);
+  }
+  pop_off();
+  return r;
+}
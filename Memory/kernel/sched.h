@@ -0,0 +1,9 @@
+// Scheduling classes, for setsched().
+// Both the kernel and user programs use this header file.
+
+#define SCHED_FAIR 0  // share of the CPU by weight (the default)
+#define SCHED_PRIO 1  // fixed priority, above every SCHED_FAIR process
+
+#define NPRIO       8   // SCHED_PRIO priorities: 0 (low) .. NPRIO-1
+#define FAIRWEIGHT  10  // default SCHED_FAIR weight
+#define MAXWEIGHT   100 // SCHED_FAIR weights: 1 .. MAXWEIGHT
@@ -0,0 +1,61 @@
+// Sequence locks.
+//
+// Writer:
+//   writeseqlock(&sl); ... update ...; writesequnlock(&sl);
+// Reader:
+//   do {
+//     s = readseqbegin(&sl);
+//     ... copy out the data ...
+//   } while(readseqretry(&sl, s));
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "seqlock.h"
+#include "defs.h"
+
+void
+initseqlock(struct seqlock *sl, char *name)
+{
+  initlock(&sl->lock, name);
+  sl->seq = 0;
+}
+
+void
+writeseqlock(struct seqlock *sl)
+{
+  acquire(&sl->lock);
+  sl->seq++;
+  __sync_synchronize();
+}
+
+void
+writesequnlock(struct seqlock *sl)
+{
+  __sync_synchronize();
+  sl->seq++;
+  release(&sl->lock);
+}
+
+// Wait out any write in progress and return the sequence
+// number to pass to readseqretry().
+uint
+readseqbegin(struct seqlock *sl)
+{
+  uint s;
+
+  while((s = *(volatile uint*)&sl->seq) & 1)
+    ;
+  __sync_synchronize();
+  return s;
+}
+
+// Did a write happen since readseqbegin() returned s?
+int
+readseqretry(struct seqlock *sl, uint s)
+{
+  __sync_synchronize();
+  return *(volatile uint*)&sl->seq != s;
+}
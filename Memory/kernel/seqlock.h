@@ -0,0 +1,8 @@
+// Sequence lock, for small data that is read far more often
+// than written. Writers serialize on a spinlock and make seq
+// odd while they write; readers take no lock and retry if seq
+// changed or was odd.
+struct seqlock {
+  uint seq;              // Odd while a write is in progress.
+  struct spinlock lock;  // Serializes writers.
+};
@@ -4,16 +4,69 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "lockstat.h"
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
 
+// Statistics shared by all locks with one name. Each CPU
+// updates its own slot, with interrupts off, so no atomics
+// are needed.
+struct lockclass {
+  char *name;
+  struct {
+    uint64 acquires;
+    uint64 contended;
+    uint64 spin;
+    uint64 maxhold;
+  } cpu[NCPU];
+};
+
+struct lockclass lockclasses[NLOCKSTAT];
+int nlockclass;
+uint lockclassbusy;  // guards adding to lockclasses[]
+
+// Find or add the statistics entry for name.
+// Returns 0 if the table is full.
+static struct lockclass*
+lockclass(char *name)
+{
+  struct lockclass *lc;
+  int i;
+
+  push_off();
+  while(__sync_lock_test_and_set(&lockclassbusy, 1) != 0)
+    ;
+  __sync_synchronize();
+  lc = 0;
+  for(i = 0; i < nlockclass; i++){
+    if(strncmp(lockclasses[i].name, name, 16) == 0){
+      lc = &lockclasses[i];
+      break;
+    }
+  }
+  if(lc == 0 && nlockclass < NLOCKSTAT){
+    // fill in the entry before counting it: lockstats() reads
+    // nlockclass without lockclassbusy.
+    lc = &lockclasses[nlockclass];
+    lc->name = name;
+    __sync_synchronize();
+    nlockclass++;
+  }
+  __sync_synchronize();
+  __sync_lock_release(&lockclassbusy);
+  pop_off();
+  return lc;
+}
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->class = lockclass(name);
 }
 
 // Acquire the lock.
@@ -21,16 +74,24 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket;
+  uint64 t0, now;
+  int id;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  // Take a ticket and wait for it to be served; waiters get
+  // the lock in the order they arrived. On RISC-V,
+  // __sync_fetch_and_add turns into amoadd.w.
+  ticket = __sync_fetch_and_add(&lk->next, 1);
+  t0 = 0;
+  if(*(volatile uint*)&lk->owner != ticket){
+    t0 = r_time();
+    while(*(volatile uint*)&lk->owner != ticket)
+      ;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,15 +101,36 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  now = r_time();
+  lk->acqat = now;
+  if(lk->class){
+    id = cpuid();
+    lk->class->cpu[id].acquires++;
+    if(t0){
+      lk->class->cpu[id].contended++;
+      lk->class->cpu[id].spin += now - t0;
+    }
+  }
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  uint64 held;
+  int id;
+
   if(!holding(lk))
     panic("release");
 
+  if(lk->class){
+    held = r_time() - lk->acqat;
+    id = cpuid();
+    if(held > lk->class->cpu[id].maxhold)
+      lk->class->cpu[id].maxhold = held;
+  }
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,14 +141,9 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // Serve the next ticket. Only the holder writes owner, but an
+  // atomic add keeps it a single store.
+  __sync_fetch_and_add(&lk->owner, 1);
 
   pop_off();
 }
@@ -77,10 +154,38 @@ int
 holding(struct spinlock *lk)
 {
   int r;
-  r = (lk->locked && lk->cpu == mycpu());
+  r = (lk->owner != lk->next && lk->cpu == mycpu());
   return r;
 }
 
+// Copy up to n lock statistics entries, summed over CPUs, to
+// user address addr. Returns the number copied.
+int
+lockstats(uint64 addr, int n)
+{
+  struct lockstat st;
+  struct lockclass *lc;
+  int i, j, nclass;
+
+  nclass = nlockclass;
+  __sync_synchronize();  // pairs with lockclass()
+  for(i = 0; i < n && i < nclass; i++){
+    lc = &lockclasses[i];
+    memset(&st, 0, sizeof(st));
+    safestrcpy(st.name, lc->name, sizeof(st.name));
+    for(j = 0; j < NCPU; j++){
+      st.acquires += lc->cpu[j].acquires;
+      st.contended += lc->cpu[j].contended;
+      st.spin += lc->cpu[j].spin;
+      if(lc->cpu[j].maxhold > st.maxhold)
+        st.maxhold = lc->cpu[j].maxhold;
+    }
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -1,9 +1,15 @@
 // Mutual exclusion lock.
+// A ticket lock: acquirers take a ticket from next and are
+// served in order as owner advances.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket now being served.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
-};
 
+  // For lockstat():
+  struct lockclass *class;  // Statistics for locks of this name.
+  uint64 acqat;      // When it was acquired.
+};
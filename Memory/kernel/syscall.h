@@ -20,3 +20,11 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_hmkdir 22
+#define SYS_fcntl  23
+#define SYS_splice 24
+#define SYS_vmsplice 25
+#define SYS_tracedump 26
+#define SYS_setsched 27
+#define SYS_nanosleep 28
+#define SYS_lockstat 29
@@ -176,6 +176,17 @@ isdirempty(struct inode *dp)
   int off;
   struct dirent de;
 
+  if(dp->major == DIRFMT_HASHED){
+    // "." and ".." can be in any bucket.
+    for(off=0; off<dp->size; off+=sizeof(de)){
+      if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+        panic("isdirempty: readi");
+      if(de.inum != 0 && namecmp(de.name, ".") != 0 && namecmp(de.name, "..") != 0)
+        return 0;
+    }
+    return 1;
+  }
+
   for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("isdirempty: readi");
@@ -220,6 +231,8 @@ sys_unlink(void)
   }
 
   memset(&de, 0, sizeof(de));
+  if(dp->major == DIRFMT_HASHED)
+    de.name[0] = DIRTOMB;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
   if(ip->type == T_DIR){
@@ -271,6 +284,8 @@ create(char *path, short type, short major, short minor)
   ip->major = major;
   ip->minor = minor;
   ip->nlink = 1;
+  if(type == T_DIR && major == DIRFMT_HASHED)
+    ip->size = DIRHASH_NBUCKETS*sb.bsize;  // sparse: buckets are allocated on use
   iupdate(ip);
 
   if(type == T_DIR){  // Create . and .. entries.
@@ -377,7 +392,24 @@ sys_mkdir(void)
   struct inode *ip;
 
   begin_op();
-  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, DIRFMT_LINEAR, 0)) == 0){
+    end_op();
+    return -1;
+  }
+  iunlockput(ip);
+  end_op();
+  return 0;
+}
+
+// Like mkdir, but the new directory uses the hashed format.
+uint64
+sys_hmkdir(void)
+{
+  char path[MAXPATH];
+  struct inode *ip;
+
+  begin_op();
+  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, DIRFMT_HASHED, 0)) == 0){
     end_op();
     return -1;
   }
@@ -503,3 +535,60 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  argint(1, &cmd);
+  argint(2, &arg);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  if(f->type != FD_PIPE)
+    return -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    return pipesize(f->pipe, 0);
+  case F_SETPIPE_SZ:
+    if(arg <= 0)
+      return -1;
+    return pipesize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// Move data from a file to a pipe without copying it
+// through user space.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n;
+
+  argint(2, &n);
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0)
+    return -1;
+  if(n < 0)
+    return -1;
+  return filesplice(in, out, n);
+}
+
+// Give user pages to a pipe by reference.
+uint64
+sys_vmsplice(void)
+{
+  struct file *f;
+  uint64 addr;
+  int n;
+
+  argaddr(1, &addr);
+  argint(2, &n);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  if(f->writable == 0 || f->type != FD_PIPE || n < 0)
+    return -1;
+  return pipevmsplice(f->pipe, addr, n);
+}
+
@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "seqlock.h"
 
 uint64
 sys_exit(void)
@@ -53,20 +54,22 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  // wake at the n'th tick boundary from now, as ticks counts.
+  return timersleep((r_time() / TICKINTERVAL + n) * TICKINTERVAL);
+}
+
+// sleep for at least the given number of nanoseconds.
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  argaddr(0, &ns);
+  return timersleep(r_time() + ns / (1000000000 / TIMEFREQ));
 }
 
 uint64
@@ -83,10 +86,49 @@ sys_kill(void)
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  uint xticks, s;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
+  do {
+    s = readseqbegin(&tickslock);
+    xticks = ticks;
+  } while(readseqretry(&tickslock, s));
   return xticks;
 }
+
+// copy unread kernel trace events to the user.
+uint64
+sys_tracedump(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return tracedump(addr, n);
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return lockstats(addr, n);
+}
+
+uint64
+sys_setsched(void)
+{
+  int pid, class, param;
+
+  argint(0, &pid);
+  argint(1, &class);
+  argint(2, &param);
+  return setsched(pid, class, param);
+}
@@ -0,0 +1,201 @@
+//
+// Timer deadlines and tickless idle.
+//
+// Each CPU programs its own CLINT compare register for the
+// earlier of its next scheduler tick and the earliest
+// sleeping process's deadline. A CPU only takes ticks while it
+// runs a process; an idle CPU waits in wfi until a deadline, a
+// device interrupt, or a kick from a CPU that queued work.
+// Times are in time CSR units (TIMEFREQ per second).
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct proc *heap[NPROC];    // sleepers, a min-heap on p->wakeat
+  int n;
+} timers;
+
+void
+timersinit(void)
+{
+  initlock(&timers.lock, "timers");
+}
+
+static void
+swap(int i, int j)
+{
+  struct proc *p;
+
+  p = timers.heap[i];
+  timers.heap[i] = timers.heap[j];
+  timers.heap[j] = p;
+  timers.heap[i]->timeridx = i;
+  timers.heap[j]->timeridx = j;
+}
+
+static void
+siftup(int i)
+{
+  while(i > 0 && timers.heap[i]->wakeat < timers.heap[(i-1)/2]->wakeat){
+    swap(i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+siftdown(int i)
+{
+  int c;
+
+  for(;;){
+    c = 2*i + 1;
+    if(c >= timers.n)
+      break;
+    if(c+1 < timers.n && timers.heap[c+1]->wakeat < timers.heap[c]->wakeat)
+      c++;
+    if(timers.heap[i]->wakeat <= timers.heap[c]->wakeat)
+      break;
+    swap(i, c);
+    i = c;
+  }
+}
+
+static void
+heapremove(struct proc *p)
+{
+  int i = p->timeridx;
+
+  timers.n--;
+  if(i != timers.n){
+    timers.heap[i] = timers.heap[timers.n];
+    timers.heap[i]->timeridx = i;
+    siftdown(i);
+    siftup(i);
+  }
+  p->timeridx = -1;
+}
+
+static void
+setcmp(struct cpu *c, uint64 when)
+{
+  c->timerat = when;
+  *(uint64*)CLINT_MTIMECMP(c - cpus) = when;
+}
+
+// Program this CPU's compare register for its next event.
+// Caller holds timers.lock.
+static void
+timerprogram(void)
+{
+  struct cpu *c = mycpu();
+  uint64 next;
+
+  next = c->tickat ? c->tickat : ~0ULL;
+  if(timers.n > 0 && timers.heap[0]->wakeat < next)
+    next = timers.heap[0]->wakeat;
+  setcmp(c, next);
+}
+
+// Sleep until the time CSR reaches when.
+// Returns -1 if killed first.
+int
+timersleep(uint64 when)
+{
+  struct proc *p = myproc();
+
+  if(when <= r_time())
+    return 0;
+
+  acquire(&timers.lock);
+  p->wakeat = when;
+  p->timeridx = timers.n;
+  timers.heap[timers.n++] = p;
+  siftup(p->timeridx);
+  if(timers.heap[0] == p)
+    timerprogram();
+
+  while(p->timeridx >= 0){
+    if(killed(p)){
+      heapremove(p);
+      release(&timers.lock);
+      return -1;
+    }
+    sleep(&p->wakeat, &timers.lock);
+  }
+  release(&timers.lock);
+  return 0;
+}
+
+// A timer interrupt on this CPU: wake sleepers whose deadline
+// has passed, schedule the next tick if this CPU is busy, and
+// reprogram.
+void
+timerintr(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p;
+  uint64 now;
+
+  now = r_time();
+  acquire(&timers.lock);
+  while(timers.n > 0 && timers.heap[0]->wakeat <= now){
+    p = timers.heap[0];
+    heapremove(p);
+    wakeup(&p->wakeat);
+  }
+  if(c->proc == 0)
+    c->tickat = 0;  // idle; no ticks until it runs something
+  else if(c->tickat <= now)
+    c->tickat = now + TICKINTERVAL;
+  timerprogram();
+  release(&timers.lock);
+}
+
+// This CPU is about to run a process: turn its ticks back on.
+// Caller must have interrupts off.
+void
+timertick(void)
+{
+  struct cpu *c = mycpu();
+
+  if(c->tickat != 0)
+    return;
+  clockintr();  // ticks went stale while idle
+  c->tickat = r_time() + TICKINTERVAL;
+  if(c->tickat < c->timerat)
+    setcmp(c, c->tickat);
+}
+
+// Nothing to run: wait for an interrupt. With ticks off this
+// lasts until a deadline, a device, or timerkick().
+void
+timeridle(void)
+{
+  struct cpu *c = mycpu();
+
+  // wfi wakes on a pending interrupt even with interrupts
+  // off, so a kick between the check and wfi is not lost.
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if(rqempty())
+    asm volatile("wfi");
+  c->idle = 0;
+  intr_on();
+}
+
+// Make idle CPU id look for work, by forcing its timer
+// interrupt.
+void
+timerkick(int id)
+{
+  *(uint64*)CLINT_MTIMECMP(id) = 0;
+}
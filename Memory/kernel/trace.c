@@ -0,0 +1,138 @@
+//
+// Per-CPU kernel trace rings.
+//
+// trace() runs with interrupts off and only touches its own
+// CPU's ring, so it needs no lock. It marks an event complete
+// by setting seq last; a reader that finds a different seq
+// after copying the event knows it was overwritten.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+struct tracering {
+  struct traceev ev[NTRACE];
+  uint64 head;  // events written; only this CPU changes it
+  uint64 tail;  // next event to read; protected by tracelock
+  uint64 lost;  // overwritten before they were read; tracelock
+};
+
+struct tracering tracerings[NCPU];
+struct spinlock tracelock;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record an event on this CPU. name may be 0.
+void
+trace(int type, char *name, uint64 a0, uint64 a1, uint64 a2)
+{
+  struct tracering *r;
+  struct traceev *e;
+  struct proc *p;
+  uint64 i;
+
+  push_off();
+  r = &tracerings[cpuid()];
+  p = mycpu()->proc;
+  i = r->head;
+  e = &r->ev[i % NTRACE];
+
+  e->seq = 0;
+  __sync_synchronize();
+  e->time = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  e->pid = p ? p->pid : 0;
+  e->arg[0] = a0;
+  e->arg[1] = a1;
+  e->arg[2] = a2;
+  if(name)
+    safestrcpy(e->name, name, sizeof(e->name));
+  else
+    e->name[0] = 0;
+  __sync_synchronize();
+  e->seq = i + 1;
+  r->head = i + 1;
+
+  pop_off();
+}
+
+// Copy the oldest unread event of ring r to *e.
+// Skips events that were overwritten before they were read,
+// counting them in r->lost.
+// Returns 0 if r has none. Caller holds tracelock.
+static int
+tracepeek(struct tracering *r, struct traceev *e)
+{
+  struct traceev *s;
+  uint64 head;
+
+  for(;;){
+    head = r->head;
+    __sync_synchronize();
+    if(r->tail == head)
+      return 0;
+    if(head - r->tail > NTRACE){
+      r->lost += head - NTRACE - r->tail;
+      r->tail = head - NTRACE;
+    }
+    s = &r->ev[r->tail % NTRACE];
+    *e = *s;
+    __sync_synchronize();
+    if(e->seq == r->tail + 1 && s->seq == e->seq)
+      return 1;
+    r->lost++;
+    r->tail++;
+  }
+}
+
+// Copy up to n unread events, merged across CPUs in time
+// order, to user address addr. A ring that lost events reports
+// how many as a TR_LOST event before its next one.
+// Returns the number copied.
+int
+tracedump(uint64 addr, int n)
+{
+  struct traceev e, best;
+  struct tracering *r, *bestr;
+  int i;
+
+  acquire(&tracelock);
+  for(i = 0; i < n; i++){
+    bestr = 0;
+    for(r = tracerings; r < &tracerings[NCPU]; r++){
+      if(r->lost > 0){
+        memset(&best, 0, sizeof(best));
+        best.type = TR_LOST;
+        best.cpu = r - tracerings;
+        best.arg[0] = r->lost;
+        bestr = r;
+        break;
+      }
+      if(tracepeek(r, &e) && (bestr == 0 || e.time < best.time)){
+        best = e;
+        bestr = r;
+      }
+    }
+    if(bestr == 0)
+      break;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(best), (char*)&best, sizeof(best)) < 0)
+      break;
+    if(best.type == TR_LOST)
+      bestr->lost = 0;
+    else
+      bestr->tail++;
+  }
+  release(&tracelock);
+  return i;
+}
@@ -0,0 +1,25 @@
+// Kernel trace events.
+// trace() records them in a per-CPU ring without taking a lock;
+// the tracedump() system call reads them, oldest first.
+// Both the kernel and user programs use this header file.
+
+#define TR_LOST          0  // arg: events this cpu overwrote unread
+#define TR_STATIC_PROC   1  // static process creation
+#define TR_ONDEMAND_PROC 2  // on-demand process creation
+#define TR_SKIP_SECTION  3  // arg: vaddr, size
+#define TR_PAGE_FAULT    4  // arg: vaddr
+#define TR_EVICT         5  // arg: vaddr, first PSA block, last PSA block
+#define TR_RETRIEVE      6  // arg: vaddr, first PSA block, last PSA block
+#define TR_LOAD_SEG      7  // arg: vaddr, segment offset, size
+#define TR_SKIP_HEAP     8  // arg: vaddr, npages
+#define TR_COW           9  // arg: vaddr
+
+struct traceev {
+  uint64 seq;       // index in its CPU's ring, plus one
+  uint64 time;      // time CSR when recorded
+  ushort type;      // TR_*
+  ushort cpu;
+  int pid;
+  uint64 arg[3];
+  char name[16];    // process name
+};
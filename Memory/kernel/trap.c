@@ -4,9 +4,10 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "seqlock.h"
 #include "defs.h"
 
-struct spinlock tickslock;
+struct seqlock tickslock;
 uint ticks;
 
 extern char trampoline[], uservec[], userret[];
@@ -19,7 +20,7 @@ extern int devintr();
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initseqlock(&tickslock, "time");
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -83,8 +84,10 @@ usertrap(void)
   if(killed(p))
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if a queued process should run instead:
+  // at a timer interrupt, or at once for a higher class or
+  // priority (for example, one this system call woke up).
+  if(needresched(which_dev == 2))
     yield();
 
   usertrapret();
@@ -157,8 +160,9 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING) {
+  // give up the CPU if this is a timer interrupt
+  // and a queued process should run instead.
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING && needresched(1)) {
     yield();
   }
 
@@ -171,10 +175,10 @@ kerneltrap()
 void
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
+  // ticks follows the time CSR, since idle CPUs skip ticks.
+  writeseqlock(&tickslock);
+  ticks = r_time() / TICKINTERVAL;
+  writesequnlock(&tickslock);
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -213,14 +217,14 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before reprogramming the timer
+    // so that a kick arriving meanwhile is not lost.
     w_sip(r_sip() & ~2);
 
+    clockintr();
+    timerintr();
+
     return 2;
   } else {
     return 0;
@@ -35,12 +35,14 @@
 #define LSR_RX_READY (1<<0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1<<5)    // THR can accept another character to send
 
+#define FIFO_SIZE 16           // depth of the transmit FIFO
+
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE 1024
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
@@ -77,32 +79,52 @@ uartinit(void)
   initlock(&uart_tx_lock, "uart");
 }
 
-// add a character to the output buffer and tell the
+// add n bytes to the output buffer and tell the
 // UART to start sending if it isn't already.
-// blocks if the output buffer is full.
+// copies as much as fits at once, and
+// blocks while the output buffer is full.
 // because it may block, it can't be called
 // from interrupts; it's only suitable for use
 // by write().
 void
-uartputc(int c)
+uartwrite(char *buf, int n)
 {
+  int i, m;
+
   acquire(&uart_tx_lock);
 
   if(panicked){
     for(;;)
       ;
   }
-  while(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
-    // buffer is full.
-    // wait for uartstart() to open up space in the buffer.
-    sleep(&uart_tx_r, &uart_tx_lock);
+  for(i = 0; i < n; i += m){
+    while(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
+      // buffer is full.
+      // wait for uartstart() to open up space in the buffer.
+      sleep(&uart_tx_r, &uart_tx_lock);
+    }
+    // copy up to the free space or the end of the ring.
+    m = UART_TX_BUF_SIZE - (uart_tx_w - uart_tx_r);
+    if(m > UART_TX_BUF_SIZE - uart_tx_w % UART_TX_BUF_SIZE)
+      m = UART_TX_BUF_SIZE - uart_tx_w % UART_TX_BUF_SIZE;
+    if(m > n - i)
+      m = n - i;
+    memmove(&uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE], buf + i, m);
+    uart_tx_w += m;
+    uartstart();
   }
-  uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = c;
-  uart_tx_w += 1;
-  uartstart();
   release(&uart_tx_lock);
 }
 
+// add a character to the output buffer.
+void
+uartputc(int c)
+{
+  char ch = c;
+
+  uartwrite(&ch, 1);
+}
+
 
 // alternate version of uartputc() that doesn't 
 // use interrupts, for use by kernel printf() and
@@ -126,13 +148,15 @@ uartputc_sync(int c)
   pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// if the UART is idle, and characters are waiting
+// in the transmit buffer, send them.
 // caller must hold uart_tx_lock.
 // called from both the top- and bottom-half.
 void
 uartstart()
 {
+  int i;
+
   while(1){
     if(uart_tx_w == uart_tx_r){
       // transmit buffer is empty.
@@ -146,13 +170,15 @@ uartstart()
       return;
     }
     
-    int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
-    uart_tx_r += 1;
+    // with FIFOs enabled, TX_IDLE means the whole transmit
+    // FIFO is empty, so fill it without polling LSR again.
+    for(i = 0; i < FIFO_SIZE && uart_tx_r != uart_tx_w; i++){
+      WriteReg(THR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
+      uart_tx_r += 1;
+    }
     
-    // maybe uartputc() is waiting for space in the buffer.
+    // maybe uartwrite() is waiting for space in the buffer.
     wakeup(&uart_tx_r);
-    
-    WriteReg(THR, c);
   }
 }
 
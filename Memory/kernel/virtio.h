@@ -47,7 +47,8 @@
 
 // this many virtio descriptors.
 // must be a power of two.
-#define NUM 8
+// each transfer takes three, and read-ahead keeps several in flight.
+#define NUM 32
 
 // a single descriptor, from the spec.
 struct virtq_desc {
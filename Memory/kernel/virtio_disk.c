@@ -212,12 +212,14 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// hand b to the device. caller holds disk.vdisk_lock.
+// if no descriptors are free, waits for some if wait is set,
+// and otherwise gives up and returns -1.
+// returns the index of the first descriptor of the chain.
+static int
+virtio_disk_start(struct buf *b, int write, int wait)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  uint64 sector = b->blockno * (b->size / 512);
 
   // the spec's Section 5.2 says that legacy block operations use
   // three descriptors: one for type/reserved/sector, one for the
@@ -229,6 +231,8 @@ virtio_disk_rw(struct buf *b, int write)
     if(alloc3_desc(idx) == 0) {
       break;
     }
+    if(!wait)
+      return -1;
     sleep(&disk.free[0], &disk.vdisk_lock);
   }
 
@@ -250,7 +254,7 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].next = idx[1];
 
   disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
+  disk.desc[idx[1]].len = b->size;
   if(write)
     disk.desc[idx[1]].flags = 0; // device reads b->data
   else
@@ -280,17 +284,47 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
+  return idx[0];
+}
+
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  int id;
+
+  acquire(&disk.vdisk_lock);
+
+  id = virtio_disk_start(b, write, 1);
+
   // Wait for virtio_disk_intr() to say request has finished.
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  disk.info[id].b = 0;
+  free_chain(id);
 
   release(&disk.vdisk_lock);
 }
 
+// start reading locked buf b without waiting for the read.
+// virtio_disk_intr() marks b valid and releases it with
+// bdone() when the read completes.
+// returns -1, and leaves b alone, if the device is busy.
+int
+virtio_disk_read_async(struct buf *b)
+{
+  acquire(&disk.vdisk_lock);
+  b->async = 1;
+  if(virtio_disk_start(b, 0, 0) < 0){
+    b->async = 0;
+    release(&disk.vdisk_lock);
+    return -1;
+  }
+  release(&disk.vdisk_lock);
+  return 0;
+}
+
 void
 virtio_disk_intr()
 {
@@ -318,7 +352,16 @@ virtio_disk_intr()
 
     struct buf *b = disk.info[id].b;
     b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    if(b->async){
+      // nobody is waiting: finish the read-ahead here.
+      disk.info[id].b = 0;
+      free_chain(id);
+      b->async = 0;
+      b->valid = 1;
+      bdone(b);
+    } else {
+      wakeup(b);
+    }
 
     disk.used_idx += 1;
   }
@@ -15,23 +15,29 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
+#define NINODES 6000
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
-
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
+//
+// With -b the file system uses bigger blocks; the image keeps
+// the same byte size and the superblock stays at byte BSIZE.
+
+uint bsize = BSIZE;  // -b: file system block size
+int fssize;          // Size of file system in bsize blocks
+int nbitmap;
+int ninodeblocks;
 int nlog = LOGSIZE;
-int nswap = PSASIZE; // Allocating blocks in fs.img for the PSA
+int nswap;           // Allocating blocks in fs.img for the PSA
 int nmeta;           // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;         // Number of data blocks
 
 int fsfd;
 struct superblock sb;
-char zeroes[BSIZE];
+char zeroes[MAXBSIZE];
 uint freeinode = 1;
 uint freeblock;
+int hashedroot;      // -h: give the root directory the hashed format
 
 
 void balloc(int);
@@ -41,6 +47,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void dirappend(uint dirino, struct dirent *de);
 void die(const char *);
 
 // convert to riscv byte order
@@ -72,14 +79,33 @@ main(int argc, char *argv[])
   int i, cc, fd;
   uint rootino, inum, off;
   struct dirent de;
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  while(argc > 1 && argv[1][0] == '-'){
+    if(strcmp(argv[1], "-h") == 0){
+      hashedroot = 1;
+    } else if(strcmp(argv[1], "-b") == 0 && argc > 2){
+      bsize = atoi(argv[2]);
+      argc--;
+      argv++;
+    } else {
+      break;
+    }
+    argc--;
+    argv++;
+  }
+
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-h] [-b bsize] fs.img files...\n");
+    exit(1);
+  }
+  if(bsize < BSIZE || bsize > MAXBSIZE || (bsize & (bsize - 1)) != 0){
+    fprintf(stderr, "mkfs: block size must be a power of two in %d..%d\n",
+            BSIZE, MAXBSIZE);
     exit(1);
   }
 
@@ -90,13 +116,21 @@ main(int argc, char *argv[])
   if(fsfd < 0)
     die(argv[1]);
 
+  // The log holds LOGSIZE blocks of whatever size; everything
+  // else is sized in bytes and converted to bsize blocks.
+  sb.bsize = bsize;
+  fssize = FSSIZE*BSIZE/bsize;
+  nbitmap = fssize/(bsize*8) + 1;
+  ninodeblocks = NINODES / IPB(sb) + 1;
+  nswap = PSASIZE*BSIZE/bsize;
+
   // 1 fs block = 1 disk sector
   // nmeta = 2 + nlog + ninodeblocks + nbitmap;
   nmeta = 2 + nlog + nswap + ninodeblocks + nbitmap;
-  nblocks = FSSIZE - nmeta;
+  nblocks = fssize - nmeta;
 
   sb.magic = FSMAGIC;
-  sb.size = xint(FSSIZE);
+  sb.size = xint(fssize);
   sb.nblocks = xint(nblocks);
   sb.ninodes = xint(NINODES);
   sb.nlog = xint(nlog);
@@ -105,33 +139,44 @@ main(int argc, char *argv[])
   sb.swapstart    = xint(2+nlog);                // Adil
   sb.inodestart   = xint(2+nlog+nswap);            // Adil
   sb.bmapstart    = xint(2+nlog+nswap+ninodeblocks);
+  sb.bsize        = xint(bsize);
 
-  printf("nmeta %d (boot, super, log blocks %u swap blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-         nmeta, nlog, nswap, ninodeblocks, nbitmap, nblocks, FSSIZE);
+  printf("bsize %u nmeta %d (boot, super, log blocks %u swap blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
+         bsize, nmeta, nlog, nswap, ninodeblocks, nbitmap, nblocks, fssize);
   
   printf("CSE 536: Swap disk blocks (%u-%u)\n", sb.swapstart, sb.swapstart+sb.nswap);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
-  for(i = 0; i < FSSIZE; i++)
+  for(i = 0; i < fssize; i++)
     wsect(i, zeroes);
 
+  // The kernel reads the superblock at byte BSIZE before it
+  // knows the block size; that is block 1 for 1024-byte blocks
+  // and the second half of block 0 otherwise.
   memset(buf, 0, sizeof(buf));
-  memmove(buf, &sb, sizeof(sb));
-  wsect(1, buf);
+  memmove(buf + BSIZE%bsize, &sb, sizeof(sb));
+  wsect(BSIZE/bsize, buf);
 
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
+  if(hashedroot){
+    rinode(rootino, &din);
+    din.major = xshort(DIRFMT_HASHED);
+    din.size = xint(DIRHASH_NBUCKETS*bsize);
+    winode(rootino, &din);
+  }
+
   bzero(&de, sizeof(de));
   de.inum = xshort(rootino);
   strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
+  dirappend(rootino, &de);
 
   bzero(&de, sizeof(de));
   de.inum = xshort(rootino);
   strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  dirappend(rootino, &de);
 
   for(i = 2; i < argc; i++){
     // get rid of "user/"
@@ -158,7 +203,7 @@ main(int argc, char *argv[])
     bzero(&de, sizeof(de));
     de.inum = xshort(inum);
     strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    dirappend(rootino, &de);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -167,11 +212,13 @@ main(int argc, char *argv[])
   }
 
   // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  if(!hashedroot){
+    rinode(rootino, &din);
+    off = xint(din.size);
+    off = ((off/bsize) + 1) * bsize;
+    din.size = xint(off);
+    winode(rootino, &din);
+  }
 
   balloc(freeblock);
 
@@ -181,22 +228,22 @@ main(int argc, char *argv[])
 void
 wsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
+  if(lseek(fsfd, sec * bsize, 0) != sec * bsize)
     die("lseek");
-  if(write(fsfd, buf, BSIZE) != BSIZE)
+  if(write(fsfd, buf, bsize) != bsize)
     die("write");
 }
 
 void
 winode(uint inum, struct dinode *ip)
 {
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   uint bn;
   struct dinode *dip;
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = ((struct dinode*)buf) + (inum % IPB(sb));
   *dip = *ip;
   wsect(bn, buf);
 }
@@ -204,22 +251,22 @@ winode(uint inum, struct dinode *ip)
 void
 rinode(uint inum, struct dinode *ip)
 {
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   uint bn;
   struct dinode *dip;
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = ((struct dinode*)buf) + (inum % IPB(sb));
   *ip = *dip;
 }
 
 void
 rsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
+  if(lseek(fsfd, sec * bsize, 0) != sec * bsize)
     die("lseek");
-  if(read(fsfd, buf, BSIZE) != BSIZE)
+  if(read(fsfd, buf, bsize) != bsize)
     die("read");
 }
 
@@ -240,12 +287,12 @@ ialloc(ushort type)
 void
 balloc(int used)
 {
-  uchar buf[BSIZE];
+  uchar buf[MAXBSIZE];
   int i;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
+  assert(used < bsize*8);
+  bzero(buf, bsize);
   for(i = 0; i < used; i++){
     buf[i/8] = buf[i/8] | (0x1 << (i%8));
   }
@@ -255,41 +302,49 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the sector holding block fbn of inode din,
+// allocating it (and the indirect block) if necessary.
+uint
+ibmap(struct dinode *din, uint fbn)
+{
+  uint indirect[MAXBSIZE / sizeof(uint)];
+
+  assert(fbn < MAXFILE(sb));
+  if(fbn < NDIRECT){
+    if(xint(din->addrs[fbn]) == 0){
+      din->addrs[fbn] = xint(freeblock++);
+    }
+    return xint(din->addrs[fbn]);
+  }
+  if(xint(din->addrs[NDIRECT]) == 0){
+    din->addrs[NDIRECT] = xint(freeblock++);
+  }
+  rsect(xint(din->addrs[NDIRECT]), (char*)indirect);
+  if(indirect[fbn - NDIRECT] == 0){
+    indirect[fbn - NDIRECT] = xint(freeblock++);
+    wsect(xint(din->addrs[NDIRECT]), (char*)indirect);
+  }
+  return xint(indirect[fbn-NDIRECT]);
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
   char *p = (char*)xp;
   uint fbn, off, n1;
   struct dinode din;
-  char buf[BSIZE];
-  uint indirect[NINDIRECT];
+  char buf[MAXBSIZE];
   uint x;
 
   rinode(inum, &din);
   off = xint(din.size);
   // printf("append inum %d at off %d sz %d\n", inum, off, n);
   while(n > 0){
-    fbn = off / BSIZE;
-    assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
-      if(xint(din.addrs[fbn]) == 0){
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
-    n1 = min(n, (fbn + 1) * BSIZE - off);
+    fbn = off / bsize;
+    x = ibmap(&din, fbn);
+    n1 = min(n, (fbn + 1) * bsize - off);
     rsect(x, buf);
-    bcopy(p, buf + off - (fbn * BSIZE), n1);
+    bcopy(p, buf + off - (fbn * bsize), n1);
     wsect(x, buf);
     n -= n1;
     off += n1;
@@ -299,6 +354,53 @@ iappend(uint inum, void *xp, int n)
   winode(inum, &din);
 }
 
+// Same hash as dirhash() in kernel/fs.c.
+uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+// Add entry de to directory dirino, placing it in its hash
+// bucket if the directory uses the hashed format.
+void
+dirappend(uint dirino, struct dirent *de)
+{
+  struct dinode din;
+  struct dirent bucket[MAXBSIZE / sizeof(struct dirent)];
+  uint h, i, j, x;
+
+  rinode(dirino, &din);
+  if(xshort(din.major) != DIRFMT_HASHED){
+    iappend(dirino, de, sizeof(*de));
+    return;
+  }
+
+  h = dirhash(de->name);
+  for(i = 0; i < DIRHASH_NBUCKETS; i++){
+    x = ibmap(&din, (h + i) % DIRHASH_NBUCKETS);
+    rsect(x, bucket);
+    for(j = 0; j < DPB(sb); j++){
+      if(bucket[j].inum == 0){
+        bucket[j] = *de;
+        wsect(x, bucket);
+        winode(dirino, &din);
+        return;
+      }
+    }
+  }
+  fprintf(stderr, "mkfs: directory %u is full\n", dirino);
+  exit(1);
+}
+
 void
 die(const char *s)
 {
@@ -0,0 +1,96 @@
+// Directory scaling benchmark: create, look up and remove
+// many files in one directory, and report the ticks each
+// phase took.
+//
+//   dirbench [-l] [nfiles]
+//
+// By default the directory uses the hashed format (hmkdir);
+// -l uses an ordinary linear directory for comparison.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+
+#define DIR "dirbench.d"
+
+// Build DIR "/f<i>" in buf.
+static void
+fname(char *buf, int i)
+{
+  char tmp[16];
+  int n;
+
+  strcpy(buf, DIR "/f");
+  n = 0;
+  do {
+    tmp[n++] = '0' + i % 10;
+    i /= 10;
+  } while(i > 0);
+  buf += strlen(buf);
+  while(n > 0)
+    *buf++ = tmp[--n];
+  *buf = 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, fd, nfiles, linear;
+  int t0, t1, t2, t3;
+  char path[32];
+  struct stat st;
+
+  linear = 0;
+  nfiles = 5000;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-l") == 0)
+      linear = 1;
+    else
+      nfiles = atoi(argv[i]);
+  }
+
+  if((linear ? mkdir(DIR) : hmkdir(DIR)) < 0){
+    fprintf(2, "dirbench: cannot create %s\n", DIR);
+    exit(1);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < nfiles; i++){
+    fname(path, i);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      fprintf(2, "dirbench: create %s failed\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+
+  t1 = uptime();
+  for(i = 0; i < nfiles; i++){
+    fname(path, i);
+    if(stat(path, &st) < 0){
+      fprintf(2, "dirbench: lookup %s failed\n", path);
+      exit(1);
+    }
+  }
+
+  t2 = uptime();
+  for(i = 0; i < nfiles; i++){
+    fname(path, i);
+    if(unlink(path) < 0){
+      fprintf(2, "dirbench: unlink %s failed\n", path);
+      exit(1);
+    }
+  }
+  t3 = uptime();
+
+  if(unlink(DIR) < 0){
+    fprintf(2, "dirbench: cannot remove %s\n", DIR);
+    exit(1);
+  }
+
+  printf("dirbench: %d files, %s directory\n", nfiles, linear ? "linear" : "hashed");
+  printf("  create %d ticks, lookup %d ticks, unlink %d ticks\n",
+         t1 - t0, t2 - t1, t3 - t2);
+  exit(0);
+}
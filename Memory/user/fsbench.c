@@ -0,0 +1,63 @@
+// Sequential file throughput benchmark: write a file, read it
+// back, and report the ticks each phase took. Build fs.img with
+// a different FSBLOCK to compare block sizes.
+//
+//   fsbench [kbytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+
+#define FILE "fsbench.f"
+
+char buf[4096];
+
+int
+main(int argc, char *argv[])
+{
+  int i, fd, n, kbytes;
+  int t0, t1, t2;
+  struct stat st;
+
+  kbytes = 256;
+  if(argc > 1)
+    kbytes = atoi(argv[1]);
+  n = kbytes * 1024 / sizeof(buf);
+
+  if((fd = open(FILE, O_CREATE | O_RDWR)) < 0){
+    fprintf(2, "fsbench: cannot create %s\n", FILE);
+    exit(1);
+  }
+  memset(buf, 'a', sizeof(buf));
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "fsbench: write failed at %d\n", i);
+      exit(1);
+    }
+  }
+  fstat(fd, &st);
+  close(fd);
+
+  t1 = uptime();
+  if((fd = open(FILE, O_RDONLY)) < 0){
+    fprintf(2, "fsbench: cannot open %s\n", FILE);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "fsbench: read failed at %d\n", i);
+      exit(1);
+    }
+  }
+  close(fd);
+  t2 = uptime();
+
+  unlink(FILE);
+
+  printf("fsbench: %d KB, block size %d\n", kbytes, st.blksize);
+  printf("  write %d ticks, read %d ticks\n", t1 - t0, t2 - t1);
+  exit(0);
+}
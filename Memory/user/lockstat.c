@@ -0,0 +1,38 @@
+// Print spinlock statistics, one line per lock name, with the
+// locks that spent the most time spinning first.
+//
+//   lockstat
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat st[NLOCKSTAT];
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat t;
+  int i, j, n;
+
+  if((n = lockstat(st, NLOCKSTAT)) < 0){
+    fprintf(2, "lockstat: failed\n");
+    exit(1);
+  }
+
+  // insertion sort by spin time, largest first.
+  for(i = 1; i < n; i++){
+    t = st[i];
+    for(j = i; j > 0 && st[j-1].spin < t.spin; j--)
+      st[j] = st[j-1];
+    st[j] = t;
+  }
+
+  printf("name\tacquires\tcontended\tspin\tmaxhold\n");
+  for(i = 0; i < n; i++)
+    printf("%s\t%l\t%l\t%l\t%l\n", st[i].name, st[i].acquires,
+           st[i].contended, st[i].spin, st[i].maxhold);
+  exit(0);
+}
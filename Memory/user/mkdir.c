@@ -5,15 +5,18 @@
 int
 main(int argc, char *argv[])
 {
-  int i;
+  int i, hashed;
 
   if(argc < 2){
-    fprintf(2, "Usage: mkdir files...\n");
+    fprintf(2, "Usage: mkdir [-h] files...\n");
     exit(1);
   }
 
-  for(i = 1; i < argc; i++){
-    if(mkdir(argv[i]) < 0){
+  // -h: use the hashed directory format, for very large directories.
+  hashed = strcmp(argv[1], "-h") == 0;
+
+  for(i = 1 + hashed; i < argc; i++){
+    if((hashed ? hmkdir(argv[i]) : mkdir(argv[i])) < 0){
       fprintf(2, "mkdir: %s failed to create\n", argv[i]);
       break;
     }
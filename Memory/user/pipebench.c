@@ -0,0 +1,87 @@
+// Pipe throughput benchmark: a child writes to a pipe and the
+// parent reads it, and the ticks taken are reported. With -v
+// the child gives the pipe its pages with vmsplice() instead.
+//
+//   pipebench [-v] [-s pipesize] [-c chunk] [kbytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+
+char buf[8192];
+
+int
+main(int argc, char *argv[])
+{
+  int i, p[2], pid, n, total, chunk, kbytes, psize, usevm;
+  int t0, t1;
+  char *wbuf;
+
+  chunk = 4096;
+  kbytes = 4096;
+  psize = 0;
+  usevm = 0;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-v") == 0)
+      usevm = 1;
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      psize = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      chunk = atoi(argv[++i]);
+    else
+      kbytes = atoi(argv[i]);
+  }
+  if(chunk <= 0 || chunk > sizeof(buf)){
+    fprintf(2, "pipebench: chunk must be 1..%d\n", sizeof(buf));
+    exit(1);
+  }
+
+  if(pipe(p) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  if(psize > 0 && fcntl(p[1], F_SETPIPE_SZ, psize) < 0){
+    fprintf(2, "pipebench: cannot set pipe size %d\n", psize);
+    exit(1);
+  }
+  psize = fcntl(p[1], F_GETPIPE_SZ, 0);
+
+  total = kbytes * 1024;
+  t0 = uptime();
+  pid = fork(0);
+  if(pid < 0){
+    fprintf(2, "pipebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p[0]);
+    // A page-aligned buffer, so vmsplice() can share whole pages.
+    wbuf = sbrk(chunk + 4096);
+    wbuf += (4096 - (uint64)wbuf % 4096) % 4096;
+    memset(wbuf, 'x', chunk);
+    for(i = 0; i < total; i += n){
+      n = total - i < chunk ? total - i : chunk;
+      if((usevm ? vmsplice(p[1], wbuf, n) : write(p[1], wbuf, n)) != n){
+        fprintf(2, "pipebench: write failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+
+  close(p[1]);
+  for(i = 0; (n = read(p[0], buf, chunk)) > 0; i += n)
+    ;
+  close(p[0]);
+  wait(0);
+  t1 = uptime();
+
+  if(i != total){
+    fprintf(2, "pipebench: read %d bytes, expected %d\n", i, total);
+    exit(1);
+  }
+  printf("pipebench: %d KB, pipe size %d, chunk %d, %s: %d ticks\n",
+         kbytes, psize, chunk, usevm ? "vmsplice" : "write", t1 - t0);
+  exit(0);
+}
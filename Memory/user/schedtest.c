@@ -0,0 +1,58 @@
+// Scheduling class demo: CPU-bound children with different
+// SCHED_FAIR weights, and one SCHED_PRIO child, each count
+// loop iterations for a while and report them.
+//
+//   schedtest [ticks]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Spin until uptime() reaches end; return the iterations done.
+static int
+spin(int end)
+{
+  int n;
+
+  for(n = 0; uptime() < end; n++)
+    ;
+  return n;
+}
+
+static void
+child(int class, int param, int end)
+{
+  int n;
+
+  if(setsched(0, class, param) < 0){
+    fprintf(2, "schedtest: setsched failed\n");
+    exit(1);
+  }
+  n = spin(end);
+  printf("schedtest: %s %d: %d iterations\n",
+         class == SCHED_PRIO ? "prio" : "fair weight", param, n);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, end, ticks;
+  int weights[] = { 10, 20, 40 };
+
+  ticks = 50;
+  if(argc > 1)
+    ticks = atoi(argv[1]);
+  end = uptime() + ticks;
+
+  for(i = 0; i < sizeof(weights)/sizeof(weights[0]); i++)
+    if(fork(0) == 0)
+      child(SCHED_FAIR, weights[i], end);
+  if(fork(0) == 0)
+    child(SCHED_PRIO, NPRIO-1, end);
+
+  while(wait(0) >= 0)
+    ;
+  exit(0);
+}
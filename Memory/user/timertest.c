@@ -0,0 +1,35 @@
+// Sub-tick sleeps: nanosleep() many times for a short interval
+// and check that the total matches the intervals, not whole
+// ticks; a tick is 100ms.
+//
+//   timertest [count] [microseconds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, us, t0, t1;
+
+  n = argc > 1 ? atoi(argv[1]) : 200;
+  us = argc > 2 ? atoi(argv[2]) : 1000;
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(nanosleep((uint64)us * 1000) < 0){
+      fprintf(2, "timertest: nanosleep failed\n");
+      exit(1);
+    }
+  }
+  t1 = uptime();
+
+  printf("timertest: %d sleeps of %dus took %d ticks (expect about %d)\n",
+         n, us, t1 - t0, n * us / 100000);
+  if(t1 - t0 >= n){
+    fprintf(2, "timertest: sleeps are rounded up to whole ticks\n");
+    exit(1);
+  }
+  exit(0);
+}
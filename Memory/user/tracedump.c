@@ -0,0 +1,83 @@
+// Print the kernel's unread trace events, oldest first, in the
+// lines the kernel prints when built with TRACECONSOLE. Events
+// caused by tracedump itself (loading it, its page faults) are
+// left out, so running it after a test prints just the test's.
+// -t prefixes each line with its time, cpu, and pid.
+//
+//   tracedump [-t]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+struct traceev ev[32];
+int tflag;
+
+void
+print(struct traceev *e)
+{
+  uint64 *a = e->arg;
+
+  if(e->type == TR_LOST){
+    fprintf(2, "tracedump: cpu%d lost %d events\n", e->cpu, (int)a[0]);
+    return;
+  }
+  if(tflag)
+    printf("%l cpu%d pid %d: ", e->time, e->cpu, e->pid);
+  switch(e->type){
+  case TR_STATIC_PROC:
+    printf("Static process creation (proc: %s)\n", e->name);
+    break;
+  case TR_ONDEMAND_PROC:
+    printf("Ondemand process creation (proc: %s)\n", e->name);
+    break;
+  case TR_SKIP_SECTION:
+    printf("Skipping program section loading (proc: %s, addr: %x, size: %d)\n",
+           e->name, a[0], (int)a[1]);
+    break;
+  case TR_PAGE_FAULT:
+    printf("----------------------------------------\n");
+    if(tflag)
+      printf("%l cpu%d pid %d: ", e->time, e->cpu, e->pid);
+    printf("#PF: Proc (%s), Page (%x)\n", e->name, a[0]);
+    break;
+  case TR_EVICT:
+    printf("EVICT: Page (%x) --> PSA (%d - %d)\n", a[0], (int)a[1], (int)a[2]);
+    break;
+  case TR_RETRIEVE:
+    printf("RETRIEVE: Page (%x) --> PSA (%d - %d)\n", a[0], (int)a[1], (int)a[2]);
+    break;
+  case TR_LOAD_SEG:
+    printf("LOAD: Addr (%x), SEG: (%x), SIZE (%d)\n", a[0], a[1], (int)a[2]);
+    break;
+  case TR_SKIP_HEAP:
+    printf("Skipping heap region allocation (proc: %s, addr: %x, npages: %d)\n",
+           e->name, a[0], (int)a[1]);
+    break;
+  case TR_COW:
+    printf("CoW: proc(%s)[%d] Addr (%x)\n", e->name, e->pid, a[0]);
+    break;
+  default:
+    printf("event %d\n", e->type);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, me;
+
+  if(argc > 1 && strcmp(argv[1], "-t") == 0)
+    tflag = 1;
+  else if(argc > 1){
+    fprintf(2, "usage: tracedump [-t]\n");
+    exit(1);
+  }
+  me = getpid();
+  while((n = tracedump(ev, sizeof(ev)/sizeof(ev[0]))) > 0)
+    for(i = 0; i < n; i++)
+      if(ev[i].pid != me || ev[i].type == TR_LOST)
+        print(&ev[i]);
+  exit(0);
+}
@@ -1,4 +1,6 @@
 struct stat;
+struct traceev;
+struct lockstat;
 
 // system calls
 int fork(int);
@@ -22,6 +24,14 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int hmkdir(const char*);
+int fcntl(int, int, int);
+int splice(int, int, int);
+int vmsplice(int, const void*, int);
+int tracedump(struct traceev*, int);
+int setsched(int, int, int);
+int nanosleep(uint64);
+int lockstat(struct lockstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -36,3 +36,11 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("hmkdir");
+entry("fcntl");
+entry("splice");
+entry("vmsplice");
+entry("tracedump");
+entry("setsched");
+entry("nanosleep");
+entry("lockstat");
@@ -0,0 +1,85 @@
+// Wakeup cost versus process count: two processes bounce a
+// byte over a pair of pipes, so every transfer is a sleep and
+// a wakeup, while a growing number of other processes sleep on
+// channels of their own.
+//
+//   wakebench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define MAXIDLE 48
+
+// Bounce a byte rounds times; return the ticks it took.
+static int
+pingpong(int rounds)
+{
+  int p1[2], p2[2], i, pid, t0, t1;
+  char c;
+
+  if(pipe(p1) < 0 || pipe(p2) < 0){
+    fprintf(2, "wakebench: pipe failed\n");
+    exit(1);
+  }
+  if((pid = fork(0)) < 0){
+    fprintf(2, "wakebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < rounds; i++){
+      if(read(p1[0], &c, 1) != 1)
+        exit(1);
+      write(p2[1], &c, 1);
+    }
+    exit(0);
+  }
+
+  t0 = uptime();
+  c = 'x';
+  for(i = 0; i < rounds; i++){
+    write(p1[1], &c, 1);
+    if(read(p2[0], &c, 1) != 1){
+      fprintf(2, "wakebench: short read\n");
+      exit(1);
+    }
+  }
+  t1 = uptime();
+
+  wait(0);
+  close(p1[0]);
+  close(p1[1]);
+  close(p2[0]);
+  close(p2[1]);
+  return t1 - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds, nidle, i, pid;
+  int pids[MAXIDLE];
+
+  rounds = argc > 1 ? atoi(argv[1]) : 5000;
+
+  printf("wakebench: %d round trips (%d wakeups)\n", rounds, 2*rounds);
+  for(nidle = 0; nidle <= MAXIDLE; nidle += 16){
+    for(i = 0; i < nidle; i++){
+      if((pid = fork(0)) < 0){
+        fprintf(2, "wakebench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        sleep(1000000);
+        exit(0);
+      }
+      pids[i] = pid;
+    }
+    printf("  %d sleeping processes: %d ticks\n", nidle, pingpong(rounds));
+    for(i = 0; i < nidle; i++){
+      kill(pids[i]);
+      wait(0);
+    }
+  }
+  exit(0);
+}
@@ -178,6 +178,24 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+//
+// how many of n bytes a read could return without
+// sleeping, which is what has been typed up to the end of
+// a line. writes do not wait for input, so all n.
+//
+int
+consoleready(int write, int n)
+{
+  int m;
+
+  if(write)
+    return n;
+  acquire(&cons.lock);
+  m = cons.w - cons.r;
+  release(&cons.lock);
+  return m < n ? m : n;
+}
+
 void
 consoleinit(void)
 {
@@ -189,4 +207,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].ready = consoleready;
 }
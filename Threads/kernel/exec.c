@@ -25,7 +25,7 @@ exec(char *path, char **argv)
 {
   char *s, *last;
   int i, off;
-  uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
+  uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase, oldtfva;
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
@@ -76,6 +76,7 @@ exec(char *path, char **argv)
 
   p = myproc();
   uint64 oldsz = p->sz;
+  oldtfva = p->tfva;
 
   // Allocate two pages at the next page boundary.
   // Make the first inaccessible as a stack guard.
@@ -128,7 +129,9 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  p->upcall_ticks = 0;   // the handler was in the old image
+  p->tfva = TRAPFRAME;
+  proc_droppagetable(oldpagetable, oldsz, oldtfva);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
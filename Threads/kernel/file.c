@@ -129,6 +129,25 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
+// How many of n bytes could be read from (or written to) f
+// without sleeping until another process acts: 0 means the
+// read or write would block. Returns -1 if f is not open for
+// it. Files, and devices without a ready function, never
+// wait that way, so all n.
+int
+fileready(struct file *f, int write, int n)
+{
+  if(write ? f->writable == 0 : f->readable == 0)
+    return -1;
+
+  if(f->type == FD_PIPE)
+    return pipeready(f->pipe, write, n);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+     devsw[f->major].ready)
+    return devsw[f->major].ready(write, n);
+  return n;
+}
+
 // Write to file f.
 // addr is a user virtual address.
 int
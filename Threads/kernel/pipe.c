@@ -128,3 +128,20 @@ piperead(struct pipe *pi, uint64 addr, int n)
   release(&pi->lock);
   return i;
 }
+
+// How many of n bytes a read (or write) could transfer
+// without sleeping. All n if the other end is closed, since
+// the read or write then returns at once.
+int
+pipeready(struct pipe *pi, int write, int n)
+{
+  int m;
+
+  acquire(&pi->lock);
+  if(write)
+    m = pi->readopen ? PIPESIZE - (pi->nwrite - pi->nread) : n;
+  else
+    m = pi->writeopen ? pi->nwrite - pi->nread : n;
+  release(&pi->lock);
+  return m < n ? m : n;
+}
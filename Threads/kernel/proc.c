@@ -26,6 +26,20 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// Page tables shared by threads made with clone(): how many
+// processes use each, and which trapframe slots they occupy.
+// Slot i is mapped at TRAPFRAME - i*PGSIZE. A page table that
+// is not listed here has a single user. vm_lock also serializes
+// changes to a shared page table.
+struct vmshare {
+  pagetable_t pagetable;
+  int ref;
+  uint64 slots;
+} vmshares[NPROC];
+struct spinlock vm_lock;
+
+#define TFSLOT(va) ((TRAPFRAME - (va)) / PGSIZE)
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -51,6 +65,7 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&vm_lock, "vm");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -123,6 +138,8 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->upcall_ticks = 0;
+  p->tfva = TRAPFRAME;
   p->state = USED;
 
   // Allocate a trapframe page.
@@ -159,7 +176,7 @@ freeproc(struct proc *p)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
   if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+    proc_droppagetable(p->pagetable, p->sz, p->tfva);
   p->pagetable = 0;
   p->sz = 0;
   p->pid = 0;
@@ -215,6 +232,42 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
   uvmfree(pagetable, sz);
 }
 
+// Caller holds vm_lock.
+static struct vmshare*
+vmfind(pagetable_t pagetable)
+{
+  struct vmshare *v;
+
+  for(v = vmshares; v < &vmshares[NPROC]; v++)
+    if(v->pagetable == pagetable)
+      return v;
+  return 0;
+}
+
+// Stop using a page table whose trapframe mapping for this
+// process is at tfva, and free it unless threads still share it.
+void
+proc_droppagetable(pagetable_t pagetable, uint64 sz, uint64 tfva)
+{
+  struct vmshare *v;
+
+  acquire(&vm_lock);
+  if((v = vmfind(pagetable)) != 0){
+    v->slots &= ~(1L << TFSLOT(tfva));
+    if(--v->ref > 0){
+      uvmunmap(pagetable, tfva, 1, 0);
+      release(&vm_lock);
+      return;
+    }
+    v->pagetable = 0;
+  }
+  release(&vm_lock);
+
+  uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+  uvmunmap(pagetable, tfva, 1, 0);
+  uvmfree(pagetable, sz);
+}
+
 // a user program that calls exec("/init")
 // assembled from ../user/initcode.S
 // od -t xC ../user/initcode
@@ -254,10 +307,11 @@ userinit(void)
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
+// Grow or shrink user memory by n bytes, and set *oldsz to
+// the size before, read under the same lock.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
   uint64 sz;
   struct proc *p = myproc();
@@ -265,15 +319,27 @@ growproc(int n)
   /* CSE 536: For simplicity, I've made all allocations at page-level. */
   n = PGROUNDUP(n);
 
+  // threads sharing the page table must all see the new size.
+  acquire(&vm_lock);
   sz = p->sz;
+  *oldsz = sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&vm_lock);
       return -1;
     }
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  if(vmfind(p->pagetable)){
+    struct proc *q;
+    for(q = proc; q < &proc[NPROC]; q++)
+      if(q->pagetable == p->pagetable)
+        q->sz = sz;
+  } else {
+    p->sz = sz;
+  }
+  release(&vm_lock);
   return 0;
 }
 
@@ -328,6 +394,89 @@ fork(void)
   return pid;
 }
 
+// Create a thread: a new process that shares the caller's page
+// table and starts running fn(arg) on the user stack at stack.
+// Like fork(), it gets copies of the open files and must be
+// reaped with wait().
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid, slot;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct vmshare *v;
+  pagetable_t own;
+
+  // Allocate process.
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // Map its trapframe in a free slot of the shared page table.
+  acquire(&vm_lock);
+  if((v = vmfind(p->pagetable)) == 0 && (v = vmfind(0)) != 0){
+    v->pagetable = p->pagetable;
+    v->ref = 1;
+    v->slots = 1L << TFSLOT(p->tfva);
+  }
+  slot = -1;
+  for(i = 0; v && i < 64; i++){
+    if((v->slots & (1L << i)) == 0){
+      slot = i;
+      break;
+    }
+  }
+  if(slot < 0 || mappages(p->pagetable, TRAPFRAME - slot*PGSIZE, PGSIZE,
+                          (uint64)np->trapframe, PTE_R | PTE_W) < 0){
+    if(v && v->ref == 1)
+      v->pagetable = 0;
+    release(&vm_lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  v->ref++;
+  v->slots |= 1L << slot;
+  // switch tables under vm_lock, so a growproc() by another
+  // sharer finds np and updates its sz.
+  own = np->pagetable;
+  np->pagetable = p->pagetable;
+  np->tfva = TRAPFRAME - slot*PGSIZE;
+  np->sz = p->sz;
+  release(&vm_lock);
+
+  proc_freepagetable(own, 0);
+
+  // start at fn(arg) on the new stack.
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
+
+  // increment reference counts on open file descriptors.
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+
+  return pid;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -82,6 +82,13 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// user registers saved on the user stack when an upcall
+// interrupts the process, restored by upcallret().
+struct upcallframe {
+  uint64 epc;
+  uint64 regs[31];  // ra through t6, as in struct trapframe
+};
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE, PFAULT };
 
 // Per-process state
@@ -103,8 +110,14 @@ struct proc {
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // User address of the trapframe
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+
+  // timer upcall; private to the process.
+  int upcall_ticks;            // Ticks between upcalls, or 0 if off
+  int upcall_left;             // Ticks until the next one
+  uint64 upcall_handler;       // User address of the handler
 };
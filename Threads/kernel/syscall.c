@@ -102,6 +102,11 @@ extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_ctime(void);
+extern uint64 sys_guardpage(void);
+extern uint64 sys_upcall(void);
+extern uint64 sys_upcallret(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_ioready(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -128,6 +133,11 @@ static uint64 (*syscalls[])(void) = {
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
 [SYS_ctime]   sys_ctime,
+[SYS_guardpage] sys_guardpage,
+[SYS_upcall]  sys_upcall,
+[SYS_upcallret] sys_upcallret,
+[SYS_clone]  sys_clone,
+[SYS_ioready] sys_ioready,
 };
 
 void
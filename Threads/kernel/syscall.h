@@ -21,3 +21,8 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_ctime  22
+#define SYS_guardpage 23
+#define SYS_upcall 24
+#define SYS_upcallret 25
+#define SYS_clone  26
+#define SYS_ioready 27
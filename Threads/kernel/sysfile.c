@@ -79,6 +79,19 @@ sys_read(void)
   return fileread(f, p, n);
 }
 
+uint64
+sys_ioready(void)
+{
+  struct file *f;
+  int write, n;
+
+  argint(1, &write);
+  argint(2, &n);
+  if(argfd(0, 0, &f) < 0 || n < 0)
+    return -1;
+  return fileready(f, write, n);
+}
+
 uint64
 sys_write(void)
 {
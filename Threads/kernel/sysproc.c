@@ -42,8 +42,7 @@ sys_sbrk(void)
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if(growproc(n, &addr) < 0)
     return -1;
 
   return addr;
@@ -95,3 +94,69 @@ uint64
 sys_ctime(void) {
   return r_time();
 }
+
+// make the user page at addr inaccessible, as a guard
+// below a thread stack.
+uint64
+sys_guardpage(void)
+{
+  uint64 va;
+  pte_t *pte;
+  struct proc *p = myproc();
+
+  argaddr(0, &va);
+  if(va % PGSIZE != 0 || va >= p->sz)
+    return -1;
+  pte = walk(p->pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0)
+    return -1;
+  uvmclear(p->pagetable, va);
+  return 0;
+}
+
+// call handler every n timer ticks while the process runs in
+// user space, or stop if n is 0. the handler gets a pointer to
+// the interrupted registers and must pass it to upcallret().
+uint64
+sys_upcall(void)
+{
+  int n;
+  uint64 handler;
+  struct proc *p = myproc();
+
+  argint(0, &n);
+  argaddr(1, &handler);
+  if(n < 0)
+    return -1;
+  p->upcall_ticks = n;
+  p->upcall_left = n;
+  p->upcall_handler = handler;
+  return 0;
+}
+
+// resume the code an upcall interrupted.
+uint64
+sys_upcallret(void)
+{
+  uint64 addr;
+  struct upcallframe f;
+  struct trapframe *tf = myproc()->trapframe;
+
+  argaddr(0, &addr);
+  if(copyin(myproc()->pagetable, (char*)&f, addr, sizeof(f)) < 0)
+    return -1;
+  tf->epc = f.epc;
+  memmove(&tf->ra, f.regs, sizeof(f.regs));
+  return tf->a0;  // syscall() stores this in a0
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
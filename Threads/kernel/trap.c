@@ -15,6 +15,7 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+static void upcall(struct proc*);
 
 void
 trapinit(void)
@@ -79,12 +80,39 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  if(which_dev == 2){
+    if(p->upcall_ticks > 0 && --p->upcall_left <= 0){
+      p->upcall_left = p->upcall_ticks;
+      upcall(p);
+    }
     yield();
+  }
 
   usertrapret();
 }
 
+// divert p to its upcall handler: push its registers onto
+// its user stack and enter the handler with a pointer to them.
+// upcallret() resumes where it left off.
+static void
+upcall(struct proc *p)
+{
+  struct trapframe *tf = p->trapframe;
+  struct upcallframe f;
+  uint64 sp;
+
+  f.epc = tf->epc;
+  memmove(f.regs, &tf->ra, sizeof(f.regs));
+  sp = (tf->sp - sizeof(f)) & ~0xfL;
+  if(copyout(p->pagetable, sp, (char*)&f, sizeof(f)) < 0){
+    setkilled(p);
+    return;
+  }
+  tf->sp = sp;
+  tf->a0 = sp;
+  tf->epc = p->upcall_handler;
+}
+
 //
 // return to user space
 //
@@ -125,10 +153,11 @@ usertrapret(void)
   uint64 satp = MAKE_SATP(p->pagetable);
 
   // jump to userret in trampoline.S at the top of memory, which 
-  // switches to the user page table, restores user registers,
-  // and switches to user mode with sret.
+  // switches to the user page table, restores user registers
+  // from the trapframe at p->tfva, and switches to user mode
+  // with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, p->tfva);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -0,0 +1,100 @@
+// Coroutines versus ulthreads: memory per task and switch cost.
+// Each of ntasks tasks yields rounds times; for coroutines the
+// main program resumes each in turn, for threads the scheduler
+// switches between them. Times are in time CSR units (ctime()).
+//
+//   corobench [ntasks] [rounds] [coroutine stack bytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "user/ulthread.h"
+#include "user/ulcoro.h"
+
+int rounds;
+
+// A generator of 1..rounds.
+uint64
+counter(struct ulcoro *co, uint64 arg)
+{
+  for(uint64 i = 1; i <= arg; i++)
+    ulcoro_yield(co, i);
+  return 0;
+}
+
+void
+yielder(void)
+{
+  for(int i = 0; i < rounds; i++)
+    ulthread_yield();
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 args[6] = {0,0,0,0,0,0};
+  uint64 t0, t1, v, sum;
+  struct ulcoro **cos;
+  char *brk;
+  int ntasks, stacksize, i, live, comem, thmem;
+
+  ntasks = argc > 1 ? atoi(argv[1]) : 1000;
+  rounds = argc > 2 ? atoi(argv[2]) : 20;
+  stacksize = argc > 3 ? atoi(argv[3]) : 512;
+
+  if((cos = malloc(ntasks * sizeof(*cos))) == 0){
+    fprintf(2, "corobench: out of memory\n");
+    exit(1);
+  }
+
+  // Coroutines.
+  brk = sbrk(0);
+  for(i = 0; i < ntasks; i++){
+    if((cos[i] = ulcoro_create(counter, rounds, stacksize)) == 0){
+      fprintf(2, "corobench: cannot create coroutine %d\n", i);
+      exit(1);
+    }
+  }
+  comem = (sbrk(0) - brk) / ntasks;
+
+  sum = 0;
+  t0 = ctime();
+  for(live = ntasks; live > 0; ){
+    for(i = 0; i < ntasks; i++){
+      if(ulcoro_done(cos[i]))
+        continue;
+      if(ulcoro_resume(cos[i], &v))
+        sum += v;
+      else
+        live--;
+    }
+  }
+  t1 = ctime();
+  if(sum != (uint64)ntasks * rounds * (rounds + 1) / 2){
+    fprintf(2, "corobench: generators yielded the wrong values\n");
+    exit(1);
+  }
+  for(i = 0; i < ntasks; i++)
+    ulcoro_free(cos[i]);
+  printf("coroutines: %d bytes per task, %d time units per 1000 yields\n",
+         comem, (int)((t1 - t0) * 1000 / ((uint64)ntasks * rounds)));
+
+  // Threads.
+  ulthread_init(ROUNDROBIN);
+  ulthread_set_trace(false);
+  brk = sbrk(0);
+  for(i = 0; i < ntasks; i++){
+    if(!ulthread_create((uint64)yielder, 0, args, -1)){
+      fprintf(2, "corobench: cannot create thread %d\n", i);
+      exit(1);
+    }
+  }
+  thmem = (sbrk(0) - brk) / ntasks;
+
+  t0 = ctime();
+  ulthread_schedule();
+  t1 = ctime();
+  printf("ulthreads:  %d bytes per task, %d time units per 1000 yields\n",
+         thmem, (int)((t1 - t0) * 1000 / ((uint64)ntasks * rounds)));
+  exit(0);
+}
@@ -0,0 +1,113 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define NPRODUCERS 2
+#define NCONSUMERS 2
+#define NITEMS     5000   // per producer
+#define CHANSIZE   8
+
+struct ulchan chan;
+struct ulmutex lock;
+struct ulsem finished;
+int producers_left = NPRODUCERS;
+uint64 total = 0;
+int received = 0;
+
+/* Sends NITEMS values; the last producer to finish closes the channel. */
+void ul_producer(int id) {
+    for (int i = 1; i <= NITEMS; i++) {
+        if (!ulchan_send(&chan, i)) {
+            printf("[!] channel closed early\n");
+            exit(1);
+        }
+    }
+
+    ulmutex_lock(&lock);
+    if (--producers_left == 0)
+        ulchan_close(&chan);
+    ulmutex_unlock(&lock);
+
+    ulsem_post(&finished);
+    ulthread_destroy();
+}
+
+/* Receives until the channel is closed and drained. */
+void ul_consumer(int id) {
+    uint64 v, sum = 0;
+    int n = 0;
+
+    while (ulchan_recv(&chan, &v)) {
+        sum += v;
+        n++;
+    }
+
+    ulmutex_lock(&lock);
+    total += sum;
+    received += n;
+    ulmutex_unlock(&lock);
+
+    ulsem_post(&finished);
+    ulthread_destroy();
+}
+
+/* Waits on the semaphore until every other thread has finished. */
+void ul_waiter(void) {
+    for (int i = 0; i < NPRODUCERS + NCONSUMERS; i++)
+        ulsem_wait(&finished);
+    if (received != NPRODUCERS * NITEMS) {
+        printf("[!] waiter woke before the others finished\n");
+        exit(1);
+    }
+    ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64 args[6] = {0,0,0,0,0,0};
+    uint64 start_time, elapsed;
+
+    /* Initialize the user-level threading library */
+    ulthread_init(ROUNDROBIN);
+    ulthread_set_trace(false);
+
+    ulchan_init(&chan, CHANSIZE);
+    ulmutex_init(&lock);
+    ulsem_init(&finished, 0);
+
+    /* The waiter goes first so it has to park on the semaphore. */
+    ulthread_create((uint64) ul_waiter, 0, args, -1);
+    for (int i = 0; i < NCONSUMERS; i++) {
+        args[0] = i;
+        ulthread_create((uint64) ul_consumer, 0, args, -1);
+    }
+    for (int i = 0; i < NPRODUCERS; i++) {
+        args[0] = i;
+        ulthread_create((uint64) ul_producer, 0, args, -1);
+    }
+
+    /* Schedule all of the threads */
+    start_time = ctime();
+    ulthread_schedule();
+    elapsed = ctime() - start_time;
+
+    if (received != NPRODUCERS * NITEMS ||
+        total != (uint64)NPRODUCERS * NITEMS * (NITEMS + 1) / 2) {
+        printf("[!] consumers got %d items, sum %d\n", received, (int)total);
+        exit(1);
+    }
+    printf("[*] %d items in %d time units\n", received, (int)elapsed);
+    ulchan_free(&chan);
+    printf("[*] User-Level Threading Test #10 (Producer/Consumer) Complete.\n");
+    return 0;
+}
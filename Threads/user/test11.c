@@ -0,0 +1,87 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define N     1024
+#define CHUNK 64
+
+int root_tid;
+int detached_tid;
+
+/* Sum of lo..hi-1: split in two joinable threads until small, and
+ * return the result from the start function. */
+uint64 ul_sum(uint64 lo, uint64 hi) {
+    uint64 args[6] = {0,0,0,0,0,0};
+    uint64 left, right, sum = 0;
+    int t1, t2;
+
+    if (hi - lo <= CHUNK) {
+        for (uint64 i = lo; i < hi; i++)
+            sum += i;
+        return sum;
+    }
+
+    args[0] = lo;
+    args[1] = (lo + hi) / 2;
+    t1 = ulthread_create_joinable((uint64) ul_sum, 0, args, -1);
+    args[0] = (lo + hi) / 2;
+    args[1] = hi;
+    t2 = ulthread_create_joinable((uint64) ul_sum, 0, args, -1);
+    if (!t1 || !t2 || !ulthread_join(t1, &left) || !ulthread_join(t2, &right)) {
+        printf("[!] cannot create or join a child\n");
+        exit(1);
+    }
+    if (ulthread_join(t1, &left)) {
+        printf("[!] joined thread %d twice\n", t1);
+        exit(1);
+    }
+    return left + right;
+}
+
+/* Finishes without anyone joining it. */
+uint64 ul_detached(void) {
+    return 42;
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64 args[6] = {0,0,0,0,0,0};
+    uint64 sum;
+
+    /* Initialize the user-level threading library */
+    ulthread_init(ROUNDROBIN);
+    ulthread_set_trace(false);
+
+    args[1] = N;
+    root_tid = ulthread_create_joinable((uint64) ul_sum, 0, args, -1);
+    detached_tid = ulthread_create_joinable((uint64) ul_detached, 0, args, -1);
+    if (!ulthread_detach(detached_tid)) {
+        printf("[!] cannot detach thread %d\n", detached_tid);
+        exit(1);
+    }
+
+    /* Schedule all of the threads */
+    ulthread_schedule();
+
+    /* The root has finished; collect its result. */
+    if (!ulthread_join(root_tid, &sum) || sum != (uint64)N * (N - 1) / 2) {
+        printf("[!] wrong sum from thread %d\n", root_tid);
+        exit(1);
+    }
+    if (ulthread_join(detached_tid, &sum)) {
+        printf("[!] joined detached thread %d\n", detached_tid);
+        exit(1);
+    }
+    printf("[*] User-Level Threading Test #11 (Join) Complete.\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define NSLEEPERS 3
+
+int woke[NSLEEPERS];
+int nwoke = 0;
+int late = 0;
+struct ulsem never;
+struct ulsem later;
+struct ulmutex lock;
+struct ulcond cond;
+bool timedout_ok = false, signalled_ok = false, posted_ok = false;
+
+/* Sleeps 6, 4 and 2 ticks; they should wake in reverse order. */
+void ul_sleeper(int i) {
+    int ticks = 2 * (NSLEEPERS - i);
+    int start = uptime();
+
+    ulthread_sleep(ticks);
+    if (uptime() - start < ticks)
+        late++;
+    woke[nwoke++] = i;
+    ulthread_destroy();
+}
+
+/* Timed waits: one that times out, and two that are woken first. */
+void ul_waiter(void) {
+    timedout_ok = !ulsem_timedwait(&never, 2);
+    posted_ok = ulsem_timedwait(&later, 100);
+
+    ulmutex_lock(&lock);
+    signalled_ok = ulcond_timedwait(&cond, &lock, 100);
+    ulmutex_unlock(&lock);
+    ulthread_destroy();
+}
+
+void ul_waker(void) {
+    ulthread_sleep(4);
+    ulsem_post(&later);
+    ulthread_sleep(1);
+    ulmutex_lock(&lock);
+    ulcond_signal(&cond);
+    ulmutex_unlock(&lock);
+    ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64 args[6] = {0,0,0,0,0,0};
+    int start;
+
+    /* Initialize the user-level threading library */
+    ulthread_init(ROUNDROBIN);
+    ulsem_init(&never, 0);
+    ulsem_init(&later, 0);
+    ulmutex_init(&lock);
+    ulcond_init(&cond);
+
+    for (int i = 0; i < NSLEEPERS; i++) {
+        args[0] = i;
+        ulthread_create((uint64) ul_sleeper, 0, args, -1);
+    }
+    ulthread_create((uint64) ul_waiter, 0, args, -1);
+    ulthread_create((uint64) ul_waker, 0, args, -1);
+
+    /* Schedule all of the threads */
+    start = uptime();
+    ulthread_schedule();
+
+    for (int i = 0; i < NSLEEPERS; i++) {
+        if (woke[i] != NSLEEPERS - 1 - i) {
+            printf("[!] sleepers woke out of order\n");
+            exit(1);
+        }
+    }
+    if (late) {
+        printf("[!] %d sleepers woke early\n", late);
+        exit(1);
+    }
+    if (!timedout_ok || !posted_ok || !signalled_ok) {
+        printf("[!] timed waits: timeout %d, post %d, signal %d\n",
+            timedout_ok, posted_ok, signalled_ok);
+        exit(1);
+    }
+    if (uptime() - start >= 100) {
+        printf("[!] a timed wait ran to its timeout\n");
+        exit(1);
+    }
+    printf("[*] User-Level Threading Test #12 (Sleep) Complete.\n");
+    return 0;
+}
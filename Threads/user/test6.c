@@ -0,0 +1,65 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define ROUNDS  20
+#define PERROUND 50
+
+int finished = 0;
+
+void ul_start_func(int round) {
+    /* Touch the stack, so a reused stack is really used. */
+    char buf[256];
+    memset(buf, round, sizeof(buf));
+    finished++;
+
+    /* Notify for a thread exit. */
+    ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+    /* Initialize the user-level threading library */
+    ulthread_init(ROUNDROBIN);
+
+    /* Let the library allocate stacks, each with a guard page */
+    ulthread_set_stack(1, true);
+
+    /* Short-lived threads in waves; after the first wave the
+     * thread control blocks and stacks should all be reused. */
+    char *brk = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64 args[6] = {r,0,0,0,0,0};
+        for (int i = 0; i < PERROUND; i++) {
+            if (!ulthread_create((uint64) ul_start_func, 0, args, -1)) {
+                printf("[!] ulthread_create failed\n");
+                exit(1);
+            }
+        }
+        ulthread_schedule();
+        if (r == 0)
+            brk = sbrk(0);
+    }
+
+    if (finished != ROUNDS*PERROUND) {
+        printf("[!] %d of %d threads finished\n", finished, ROUNDS*PERROUND);
+        exit(1);
+    }
+    if (sbrk(0) != brk) {
+        printf("[!] memory grew after the first round\n");
+        exit(1);
+    }
+
+    printf("[*] User-Level Threading Test #6 (Thread Pool) Complete.\n");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define NTHREADS 3
+
+/* Stack region for different threads */
+char stacks[PGSIZE*MAXULTHREADS];
+
+volatile int started = 0;
+int overlapped = 0;
+
+/* Spins without ever yielding; only preemption lets the others run. */
+void ul_start_func(int a1) {
+    printf("[.] started the thread function (tid = %d, a1 = %d) \n",
+        get_current_tid(), a1);
+    started++;
+
+    /* Run until every thread has started, or give up after a while. */
+    uint64 start_time = ctime();
+    while (started < NTHREADS && ctime() - start_time < 100000000)
+        ;
+    if (started == NTHREADS)
+        overlapped++;
+
+    /* Notify for a thread exit. */
+    ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+    /* Clear the stack region */
+    memset(&stacks, 0, sizeof(stacks));
+
+    /* Initialize the user-level threading library, preempting
+     * the running thread every timer tick */
+    ulthread_init(ROUNDROBIN);
+    ulthread_set_quantum(1);
+
+    /* Create a user-level thread */
+    uint64 args[6] = {1,1,1,1,0,0};
+    for (int i = 0; i < NTHREADS; i++)
+        ulthread_create((uint64) ul_start_func, (uint64) (stacks+((i+1)*PGSIZE)), args, -1);
+
+    /* Schedule all of the threads */
+    ulthread_schedule();
+
+    if (overlapped != NTHREADS) {
+        printf("[!] threads were not preempted\n");
+        exit(1);
+    }
+    printf("[*] User-Level Threading Test #7 (RR Preemptive) Complete.\n");
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+/* Run with more than one hart (make CPUS=4 qemu) to see a speedup. */
+#define NWORKERS 4
+#define NTHREADS 8
+#define CHUNKS   4
+#define WORK     2000000
+
+uint64 results[NTHREADS];
+int workers_seen[NTHREADS];   // bit i set if worker i ran the thread
+
+/* CPU-bound work in chunks, yielding between them. Every fourth
+ * thread does four times as much, so the workers given those
+ * threads fall behind and the others steal from them. */
+void ul_start_func(int id) {
+    int chunks = (id % NWORKERS == 0) ? 4*CHUNKS : CHUNKS;
+    uint64 sum = 0;
+
+    for (int c = 0; c < chunks; c++) {
+        workers_seen[id] |= 1 << get_current_worker();
+        for (int i = 0; i < WORK; i++)
+            sum += i ^ id;
+        ulthread_yield();
+    }
+    results[id] = sum;
+
+    /* Notify for a thread exit. */
+    ulthread_destroy();
+}
+
+uint64 expected(int id) {
+    int chunks = (id % NWORKERS == 0) ? 4*CHUNKS : CHUNKS;
+    uint64 sum = 0;
+
+    for (int c = 0; c < chunks; c++)
+        for (int i = 0; i < WORK; i++)
+            sum += i ^ id;
+    return sum;
+}
+
+/* Run all the threads on n workers; return the time it took. */
+uint64 run(int n) {
+    uint64 args[6] = {0,0,0,0,0,0};
+    uint64 start_time;
+
+    ulthread_init(ROUNDROBIN);
+    ulthread_set_workers(n);
+    for (int i = 0; i < NTHREADS; i++) {
+        results[i] = 0;
+        workers_seen[i] = 0;
+        args[0] = i;
+        if (!ulthread_create((uint64) ul_start_func, 0, args, -1)) {
+            printf("[!] cannot create thread %d\n", i);
+            exit(1);
+        }
+    }
+
+    start_time = ctime();
+    ulthread_schedule();
+    return ctime() - start_time;
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64 t1, tn;
+    int seen = 0, steals = 0;
+
+    t1 = run(1);
+    tn = run(NWORKERS);
+
+    for (int i = 0; i < NTHREADS; i++) {
+        if (results[i] != expected(i)) {
+            printf("[!] thread %d computed the wrong result\n", i);
+            exit(1);
+        }
+        seen |= workers_seen[i];
+    }
+    for (int i = 0; i < NWORKERS; i++)
+        steals += ulthread_steals(i);
+
+    printf("[*] 1 worker: %d k time units, %d workers: %d k time units, %d steals\n",
+        (int)(t1 / 1000), NWORKERS, (int)(tn / 1000), steals);
+    if (seen == 1) {
+        printf("[!] threads only ran on one worker\n");
+        exit(1);
+    }
+    printf("[*] User-Level Threading Test #8 (M:N Workers) Complete.\n");
+    return 0;
+}
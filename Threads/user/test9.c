@@ -0,0 +1,90 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+
+#include "user/ulthread.h"
+#include <stdarg.h>
+
+#define NMSGS   3
+#define NROUNDS 5
+
+int fds[2];
+int worker_done = 0;
+int done_before_read = 0;
+int received = 0;
+
+/* Reads messages that a slow child process writes to a pipe. */
+void ul_reader(void) {
+    char buf[16];
+    int n;
+
+    for (int i = 0; i < NMSGS; i++) {
+        if ((n = ulthread_read(fds[0], buf, sizeof(buf))) <= 0)
+            break;
+        if (i == 0)
+            done_before_read = worker_done;
+        received += n;
+    }
+
+    /* Notify for a thread exit. */
+    ulthread_destroy();
+}
+
+/* Runs while the reader waits. */
+void ul_worker(void) {
+    for (int i = 0; i < NROUNDS; i++)
+        ulthread_yield();
+    worker_done = 1;
+
+    /* Notify for a thread exit. */
+    ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64 args[6] = {0,0,0,0,0,0};
+
+    if (pipe(fds) < 0) {
+        printf("[!] pipe failed\n");
+        exit(1);
+    }
+    int pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        for (int i = 0; i < NMSGS; i++) {
+            sleep(2);
+            write(fds[1], "hello", 5);
+        }
+        exit(0);
+    }
+    close(fds[1]);
+
+    /* Initialize the user-level threading library */
+    ulthread_init(ROUNDROBIN);
+
+    /* The reader runs first and has to wait for the child. */
+    ulthread_create((uint64) ul_reader, 0, args, -1);
+    ulthread_create((uint64) ul_worker, 0, args, -1);
+
+    /* Schedule all of the threads */
+    ulthread_schedule();
+    wait(0);
+
+    if (received != NMSGS * 5) {
+        printf("[!] reader got %d bytes\n", received);
+        exit(1);
+    }
+    if (!done_before_read) {
+        printf("[!] the waiting reader blocked the other thread\n");
+        exit(1);
+    }
+    printf("[*] User-Level Threading Test #9 (Blocking I/O) Complete.\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+/* Coroutines and generators on small stacks */
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "user/ulthread.h"
+#include "user/ulcoro.h"
+
+#include <stdbool.h>
+
+#define CANARY 0x636f726f75746e65ULL  // at the bottom of each stack
+
+struct ulcoro {
+  struct context context;   // the coroutine, while it is suspended
+  struct context caller;    // the resumer, while the coroutine runs
+  ulcoro_fn fn;
+  uint64 value;             // last yielded or returned value
+  bool done;                // fn has returned
+  uint64 *stack;            // lowest word holds CANARY
+};
+
+/* First code a coroutine runs, on its own stack. */
+static void coro_entry(struct ulcoro *co, uint64 arg) {
+  co->value = co->fn(co, arg);
+  co->done = true;
+  ulthread_context_switch(&co->context, &co->caller);
+}
+
+/* Create a coroutine that will run fn(co, arg) on a stack of
+ * stacksize bytes, or ULCORO_STACK if 0. It starts at the first
+ * ulcoro_resume(). Returns 0 if out of memory. */
+struct ulcoro *ulcoro_create(ulcoro_fn fn, uint64 arg, int stacksize) {
+  struct ulcoro *co;
+
+  if (stacksize <= 0)
+    stacksize = ULCORO_STACK;
+  if ((co = malloc(sizeof(*co) + stacksize)) == 0)
+    return 0;
+  memset(&co->context, 0, sizeof(co->context));
+  co->fn = fn;
+  co->value = 0;
+  co->done = false;
+  co->stack = (uint64 *)(co + 1);
+  co->stack[0] = CANARY;
+
+  co->context.ra = (uint64)ulthread_start;
+  co->context.sp = ((uint64)co->stack + stacksize) & ~15ULL;
+  co->context.s0 = (uint64)co;
+  co->context.s1 = arg;
+  co->context.s6 = (uint64)coro_entry;
+  return co;
+}
+
+/* Run co until it yields or returns, and store the value it yielded
+ * or returned in *value if value is not 0. Returns true if it
+ * yielded, false if it has returned (now or before). */
+bool ulcoro_resume(struct ulcoro *co, uint64 *value) {
+  if (co->done)
+    return false;
+  ulthread_context_switch(&co->caller, &co->context);
+  if (co->stack[0] != CANARY) {
+    fprintf(2, "ulcoro: stack overflow in coroutine %p\n", co);
+    exit(1);
+  }
+  if (value)
+    *value = co->value;
+  return !co->done;
+}
+
+/* Give value to the resumer and suspend until the next resume.
+ * Only co itself may call this. */
+void ulcoro_yield(struct ulcoro *co, uint64 value) {
+  co->value = value;
+  ulthread_context_switch(&co->context, &co->caller);
+}
+
+bool ulcoro_done(struct ulcoro *co) {
+  return co->done;
+}
+
+/* Free a coroutine that has returned, or will never be resumed. */
+void ulcoro_free(struct ulcoro *co) {
+  free(co);
+}
@@ -0,0 +1,26 @@
+#ifndef __ULCORO_H__
+#define __ULCORO_H__
+
+#include <stdbool.h>
+
+/* Coroutines: functions that can yield a value to whoever resumed
+ * them and later continue where they left off, for small tasks
+ * that do not need a whole ulthread. A coroutine is not scheduled;
+ * it runs only inside ulcoro_resume(), on a small stack of its own
+ * that is checked, not guarded. If the thread resuming it can be
+ * preempted, the timer upcall also runs on that stack, so allow
+ * about 1KB for it. */
+
+#define ULCORO_STACK 1024   // default stack size in bytes
+
+struct ulcoro;
+
+typedef uint64 (*ulcoro_fn)(struct ulcoro *co, uint64 arg);
+
+struct ulcoro *ulcoro_create(ulcoro_fn fn, uint64 arg, int stacksize);
+bool ulcoro_resume(struct ulcoro *co, uint64 *value);
+void ulcoro_yield(struct ulcoro *co, uint64 value);
+bool ulcoro_done(struct ulcoro *co);
+void ulcoro_free(struct ulcoro *co);
+
+#endif
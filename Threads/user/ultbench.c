@@ -0,0 +1,46 @@
+// Context switch cost: two ulthreads yield to each other. In
+// each round both yield once, which is four context switches
+// (each thread to the scheduler and back). Times are in time
+// CSR units, the clock user code can read here (ctime()).
+//
+//   ultbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "user/ulthread.h"
+
+int rounds;
+
+void
+pingpong(void)
+{
+  for(int i = 0; i < rounds; i++)
+    ulthread_yield();
+  ulthread_destroy();
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 args[6] = {0,0,0,0,0,0};
+  uint64 t0, t1;
+
+  rounds = argc > 1 ? atoi(argv[1]) : 100000;
+
+  ulthread_init(ROUNDROBIN);
+  ulthread_set_trace(false);
+  if(!ulthread_create((uint64)pingpong, 0, args, -1) ||
+     !ulthread_create((uint64)pingpong, 0, args, -1)){
+    fprintf(2, "ultbench: cannot create threads\n");
+    exit(1);
+  }
+
+  t0 = ctime();
+  ulthread_schedule();
+  t1 = ctime();
+
+  printf("ultbench: %d rounds in %d time units, %d per 1000 rounds\n",
+         rounds, (int)(t1 - t0), (int)((t1 - t0) * 1000 / rounds));
+  exit(0);
+}
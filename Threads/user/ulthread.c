@@ -9,165 +9,1201 @@
 /* Standard definitions */
 #include <stdbool.h>
 #include <stddef.h> 
+#include <stdarg.h>
 
-struct context {
-  uint64 ra;
-  uint64 sp;
-  uint64 s0;
-  uint64 s1;
-  uint64 s2;
-  uint64 s3;
-  uint64 s4;
-  uint64 s5;
-  uint64 s6;
-  uint64 s7;
-  uint64 s8;
-  uint64 s9;
-  uint64 s10;
-  uint64 s11;
-  uint64 a0;
-  uint64 a1;
-  uint64 a2;
-  uint64 a3;
-  uint64 a4;
-  uint64 a5;
-};
+void vprintf(int, const char *, va_list);
 
 struct ulthread {
   int thread_id;
   enum ulthread_state state;
   int priority;
-  long last_scheduled_time;
   struct context context;
-  uint64 stack;
+  uint64 start;             // thread function
+  uint64 stack;             // lowest address of its stack
+  bool pooled_stack;        // stack came from the pool, not the caller
+  int waitfd;               // WAITIO: the fd it waits for
+  bool waitwrite;           // WAITIO: to write, not read
+  bool joinable;            // kept after it finishes until joined
+  bool joined;              // a join has claimed it
+  uint64 retval;            // its start function's return value
+  struct ulqueue joiners;   // the thread waiting in ulthread_join()
+  struct ulthread *hnext;   // next in its joinable_threads chain
+  struct ulqueue *waitq;    // WAITING: the queue it is on, if any
+  struct ullock *waitlk;    // WAITING: the lock protecting waitq
+  uint64 wakeat;            // timed wait: uptime() to give up at
+  int timeridx;             // index in timerw's heap, or -1
+  struct worker *timerw;    // worker whose heap holds it
+  bool timedout;            // its last timed wait expired
+  struct ulthread *next;    // next in its queue or free list
+};
+
+/* A worker is a kernel thread running the scheduler. Worker 0 is the
+ * process that calls ulthread_schedule(); the others are made with
+ * clone() and share its memory. Each keeps a pointer to its struct
+ * worker in the tp register, which ulthread contexts do not save, so
+ * a thread that moves to another worker sees the new one. */
+struct worker {
+  int id;
+  int pid;                           // of a cloned worker, or 0
+  struct ullock lock;                // protects the run queues
+  /* ROUNDROBIN and FCFS share one queue; PRIORITY has one per level,
+   * with a bit set in prio_bitmap for each non-empty level. */
+  struct ulqueue ready_queue;
+  struct ulqueue prio_queues[MAXPRIO];
+  uint prio_bitmap;
+  struct ulthread *parked;           // threads in WAITIO
+  struct ullock *park_lock;          // released once a WAITING thread is off its stack
+  /* Timed waits of threads that parked on this worker, a min-heap
+   * on wakeat; lock protects it too. */
+  struct ulthread **timers;
+  int ntimers;
+  int timercap;
+  struct ulthread scheduler_thread;
+  struct ulthread *current_thread;
+  /* Preemption: a timer upcall switches threads, unless it lands
+   * inside the library (busy). */
+  volatile bool busy;
+  int steals;                        // threads taken from other workers
+  char *stack;                       // scheduler stack of a cloned worker
 };
 
-struct ulthread scheduler_thread;
-struct ulthread threads[MAXULTHREADS];
-struct ulthread *current_thread = 0;
+struct worker workers[MAXWORKERS];
+int nworkers = 1;
+int next_worker = 0;        // where ulthread_create puts the next thread
 enum ulthread_scheduling_algorithm scheduling_algorithm;
 
+struct ullock pool_lock;    // thread ids and the pools below
+struct ullock join_lock;    // joinable_threads and their join state
+struct ullock print_lock;   // one trace line at a time
+
+/* Thread control blocks and stacks are recycled through free lists.
+ * Free stacks are linked through their lowest word. */
+struct ulthread *free_threads;
+uint64 free_stacks;
+int stack_pages = 1;        // pages in each pooled stack
+bool stack_guard = false;   // an inaccessible page below each pooled stack
+bool stacks_allocated = false;
+
 int next_thread_tid = 1;
-int runnable_threads = 0;
+volatile int runnable_threads = 0;
+
+/* Joinable threads that have not been joined, by thread id */
+#define NTIDHASH 64
+struct ulthread *joinable_threads[NTIDHASH];
+
+/* A timer upcall every preempt_quantum ticks, or never if 0 */
+int preempt_quantum = 0;
+
+bool tracing = true;        // print the [*] trace messages
+
+static void ullock_acquire(struct ullock *l) {
+  while (__sync_lock_test_and_set(&l->locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+static void ullock_release(struct ullock *l) {
+  __sync_synchronize();
+  __sync_lock_release(&l->locked);
+}
+
+static bool ullock_try(struct ullock *l) {
+  if (__sync_lock_test_and_set(&l->locked, 1) != 0)
+    return false;
+  __sync_synchronize();
+  return true;
+}
+
+/* The worker running this code */
+static struct worker *mywork(void) {
+  struct worker *w;
+  asm volatile("mv %0, tp" : "=r" (w));
+  return w;
+}
+
+/* Mark this worker busy, so the upcall leaves the caller alone, and
+ * return it. Until the flag is set the thread can be preempted and
+ * resume on another worker, so check it was set on the right one. */
+static struct worker *lib_enter(void) {
+  struct worker *w;
+
+  do {
+    w = mywork();
+    w->busy = true;
+  } while (w != mywork());
+  return w;
+}
+
+/* Leave the library; the thread can be preempted again. */
+static void lib_leave(void) {
+  mywork()->busy = false;
+}
+
+/* Print a library trace message without mixing it with another
+ * worker's. */
+static void trace(const char *fmt, ...) {
+  va_list ap;
+
+  if (!tracing)
+    return;
+  va_start(ap, fmt);
+  ullock_acquire(&print_lock);
+  vprintf(1, fmt, ap);
+  ullock_release(&print_lock);
+  va_end(ap);
+}
+
+/* Highest set bit of a non-zero x */
+static int highest_bit(uint x) {
+  int b = 0;
+  if (x >> 16) { x >>= 16; b += 16; }
+  if (x >> 8)  { x >>= 8;  b += 8; }
+  if (x >> 4)  { x >>= 4;  b += 4; }
+  if (x >> 2)  { x >>= 2;  b += 2; }
+  if (x >> 1)  { b += 1; }
+  return b;
+}
+
+static int prio_level(struct ulthread *t) {
+  if (t->priority < 0)
+    return 0;
+  if (t->priority >= MAXPRIO)
+    return MAXPRIO - 1;
+  return t->priority;
+}
+
+/* Add t at the back of q, or at the front. */
+static void qpush(struct ulqueue *q, struct ulthread *t, bool front) {
+  if (q->head == 0) {
+    t->next = 0;
+    q->head = q->tail = t;
+  } else if (front) {
+    t->next = q->head;
+    q->head = t;
+  } else {
+    t->next = 0;
+    q->tail->next = t;
+    q->tail = t;
+  }
+}
+
+/* Remove t from q, if it is there. */
+static void qremove(struct ulqueue *q, struct ulthread *t) {
+  struct ulthread *prev = 0, *p;
+
+  for (p = q->head; p != 0; prev = p, p = p->next) {
+    if (p != t)
+      continue;
+    if (prev)
+      prev->next = t->next;
+    else
+      q->head = t->next;
+    if (q->tail == t)
+      q->tail = prev;
+    t->next = 0;
+    return;
+  }
+}
+
+/* Remove and return the thread at the front of q, or 0. */
+static struct ulthread *qpop(struct ulqueue *q) {
+  struct ulthread *t = q->head;
+
+  if (t == 0)
+    return 0;
+  q->head = t->next;
+  if (q->head == 0)
+    q->tail = 0;
+  t->next = 0;
+  return t;
+}
+
+/* Make t ready to run on w, at the back of its queue, or at the front
+ * to keep its place ahead of threads that arrived after it.
+ * Caller holds w->lock. */
+static void enqueue(struct worker *w, struct ulthread *t, bool front) {
+  struct ulqueue *q = &w->ready_queue;
+  int level;
+
+  if (scheduling_algorithm == PRIORITY) {
+    level = prio_level(t);
+    q = &w->prio_queues[level];
+    w->prio_bitmap |= 1U << level;
+  }
+
+  qpush(q, t, front);
+}
+
+/* Remove and return w's next thread to run, or 0 if none is ready.
+ * Caller holds w->lock. */
+static struct ulthread *dequeue(struct worker *w) {
+  struct ulqueue *q = &w->ready_queue;
+  struct ulthread *t;
+  int level = 0;
+
+  if (scheduling_algorithm == PRIORITY) {
+    if (w->prio_bitmap == 0)
+      return 0;
+    level = highest_bit(w->prio_bitmap);
+    q = &w->prio_queues[level];
+  }
+
+  if ((t = qpop(q)) == 0)
+    return 0;
+  if (q->head == 0 && scheduling_algorithm == PRIORITY)
+    w->prio_bitmap &= ~(1U << level);
+  return t;
+}
+
+static void timer_swap(struct worker *w, int i, int j) {
+  struct ulthread *t = w->timers[i];
+
+  w->timers[i] = w->timers[j];
+  w->timers[j] = t;
+  w->timers[i]->timeridx = i;
+  w->timers[j]->timeridx = j;
+}
+
+static void timer_siftup(struct worker *w, int i) {
+  while (i > 0 && w->timers[i]->wakeat < w->timers[(i-1)/2]->wakeat) {
+    timer_swap(w, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void timer_siftdown(struct worker *w, int i) {
+  int c;
+
+  for (;;) {
+    c = 2*i + 1;
+    if (c >= w->ntimers)
+      break;
+    if (c+1 < w->ntimers && w->timers[c+1]->wakeat < w->timers[c]->wakeat)
+      c++;
+    if (w->timers[i]->wakeat <= w->timers[c]->wakeat)
+      break;
+    timer_swap(w, i, c);
+    i = c;
+  }
+}
+
+/* Add t to w's timer heap, growing it if full. Caller holds w->lock.
+ * Returns false if out of memory. */
+static bool timer_add(struct worker *w, struct ulthread *t) {
+  struct ulthread **heap;
+
+  if (w->ntimers == w->timercap) {
+    ullock_acquire(&pool_lock);
+    heap = malloc(2 * (w->timercap + 8) * sizeof(*heap));
+    if (heap != 0 && w->timers != 0) {
+      memmove(heap, w->timers, w->ntimers * sizeof(*heap));
+      free(w->timers);
+    }
+    ullock_release(&pool_lock);
+    if (heap == 0)
+      return false;
+    w->timers = heap;
+    w->timercap = 2 * (w->timercap + 8);
+  }
+  t->timerw = w;
+  t->timeridx = w->ntimers;
+  w->timers[w->ntimers++] = t;
+  timer_siftup(w, t->timeridx);
+  return true;
+}
+
+/* Caller holds t->timerw->lock. */
+static void timer_remove(struct ulthread *t) {
+  struct worker *w = t->timerw;
+  int i = t->timeridx;
+
+  w->ntimers--;
+  if (i != w->ntimers) {
+    w->timers[i] = w->timers[w->ntimers];
+    w->timers[i]->timeridx = i;
+    timer_siftdown(w, i);
+    timer_siftup(w, i);
+  }
+  t->timeridx = -1;
+}
+
+/* Park the running thread on q until unpark() picks it, or until
+ * uptime() reaches when if when is not 0. The caller holds lk,
+ * which protects q, with its worker busy; the scheduler releases
+ * lk once the thread is off its stack, so a waker cannot run it
+ * before then. Returns false if the wait timed out. */
+static bool park_until(struct ulqueue *q, struct ullock *lk, uint64 when) {
+  struct worker *w = mywork();
+  struct ulthread *t = w->current_thread;
+  bool added;
+
+  t->timedout = false;
+  t->timeridx = -1;
+  t->waitq = q;
+  t->waitlk = lk;
+  if (when != 0) {
+    t->wakeat = when;
+    if (lk != &w->lock)
+      ullock_acquire(&w->lock);
+    added = timer_add(w, t);
+    if (lk != &w->lock)
+      ullock_release(&w->lock);
+    // Out of memory: on a queue, wait without the timeout; with
+    // nothing else to wake the thread, time out at once.
+    if (!added && q == 0) {
+      t->waitlk = 0;
+      ullock_release(lk);
+      return false;
+    }
+  }
+  if (q != 0)
+    qpush(q, t, false);
+  t->state = WAITING;
+  w->park_lock = lk;
+  w->scheduler_thread.state = RUNNING;
+  ulthread_context_switch(&t->context, &w->scheduler_thread.context);
+  return !t->timedout;
+}
+
+static void park(struct ulqueue *q, struct ullock *lk) {
+  park_until(q, lk, 0);
+}
+
+/* Make the longest-waiting thread on q runnable on this worker,
+ * cancelling its timeout. Caller holds q's lock. Returns false if
+ * none was waiting. */
+static bool unpark(struct ulqueue *q) {
+  struct worker *w = mywork();
+  struct ulthread *t;
+
+  if ((t = qpop(q)) == 0)
+    return false;
+  t->waitq = 0;
+  if (t->timeridx >= 0) {
+    ullock_acquire(&t->timerw->lock);
+    if (t->timeridx >= 0)
+      timer_remove(t);
+    ullock_release(&t->timerw->lock);
+  }
+  t->state = RUNNABLE;
+  ullock_acquire(&w->lock);
+  enqueue(w, t, false);
+  ullock_release(&w->lock);
+  return true;
+}
+
+/* Wake w's threads whose timed waits have expired. A thread also
+ * waiting on a queue must be taken off it under that queue's lock,
+ * but a waker holding that lock may be waiting for w->lock to
+ * cancel the timeout; so only try the lock, and leave the thread
+ * for the next pass if it is taken. */
+static void expire_timers(struct worker *w) {
+  struct ulthread *t;
+  struct ullock *lk;
+  uint64 now = uptime();
+
+  ullock_acquire(&w->lock);
+  while (w->ntimers > 0 && w->timers[0]->wakeat <= now) {
+    t = w->timers[0];
+    lk = t->waitlk != &w->lock ? t->waitlk : 0;  // not a plain sleep
+    if (lk && !ullock_try(lk))
+      break;
+    timer_remove(t);
+    if (t->waitq) {
+      qremove(t->waitq, t);
+      t->waitq = 0;
+    }
+    t->timedout = true;
+    t->state = RUNNABLE;
+    enqueue(w, t, false);
+    if (lk)
+      ullock_release(lk);
+  }
+  ullock_release(&w->lock);
+}
+
+/* w has nothing to run: take the next thread from another worker,
+ * or return 0 if they have none either. */
+static struct ulthread *steal(struct worker *w) {
+  struct worker *v;
+  struct ulthread *t;
+
+  for (int i = 1; i < nworkers; i++) {
+    v = &workers[(w->id + i) % nworkers];
+    if (v->ready_queue.head == 0 && v->prio_bitmap == 0)
+      continue;  // looks empty; not worth the lock
+    ullock_acquire(&v->lock);
+    t = dequeue(v);
+    ullock_release(&v->lock);
+    if (t != 0) {
+      w->steals++;
+      return t;
+    }
+  }
+  return 0;
+}
+
+static struct ulthread *alloc_thread(void) {
+  struct ulthread *t;
+
+  if (free_threads == 0) {
+    t = malloc(ULTBATCH * sizeof(struct ulthread));
+    if (t == 0)
+      return 0;
+    for (int i = 0; i < ULTBATCH; i++) {
+      t[i].next = free_threads;
+      free_threads = &t[i];
+    }
+  }
+  t = free_threads;
+  free_threads = t->next;
+  return t;
+}
+
+/* Return the lowest address of a free pooled stack, or 0. */
+static uint64 alloc_stack(void) {
+  uint64 base, pad;
+  int npages = stack_pages + (stack_guard ? 1 : 0);
+
+  if (free_stacks != 0) {
+    base = free_stacks;
+    free_stacks = *(uint64 *)base;
+    return base;
+  }
+
+  // Page-align the break, which malloc() may have left unaligned.
+  base = (uint64)sbrk(0);
+  pad = PGROUNDUP(base) - base;
+  if (sbrk(pad + npages * PGSIZE) == (char *)-1)
+    return 0;
+  base += pad;
+  if (stack_guard) {
+    if (guardpage((void *)base) < 0)
+      return 0;
+    base += PGSIZE;
+  }
+  stacks_allocated = true;
+  return base;
+}
+
+/* Return a finished thread's stack to the pool. */
+static void free_stack(struct ulthread *t) {
+  ullock_acquire(&pool_lock);
+  if (t->pooled_stack) {
+    *(uint64 *)t->stack = free_stacks;
+    free_stacks = t->stack;
+    t->pooled_stack = false;
+  }
+  ullock_release(&pool_lock);
+}
+
+/* Return a finished thread and its stack to the pools. */
+static void free_thread(struct ulthread *t) {
+  free_stack(t);
+  ullock_acquire(&pool_lock);
+  t->next = free_threads;
+  free_threads = t;
+  ullock_release(&pool_lock);
+}
+
+/* Find joinable thread tid and unlink it from joinable_threads if
+ * unlink is set, or return 0. Caller holds join_lock. */
+static struct ulthread *find_joinable(int tid, bool unlink) {
+  struct ulthread **pp, *t;
+
+  for (pp = &joinable_threads[tid % NTIDHASH]; (t = *pp) != 0; pp = &t->hnext) {
+    if (t->thread_id == tid) {
+      if (unlink)
+        *pp = t->hnext;
+      return t;
+    }
+  }
+  return 0;
+}
+
+/* Set the size of the stacks the library allocates, and whether each
+ * gets a guard page. Only possible before the first is allocated. */
+bool ulthread_set_stack(int npages, bool guard) {
+  if (stacks_allocated || npages < 1)
+    return false;
+  stack_pages = npages;
+  stack_guard = guard;
+  return true;
+}
+
+/* Set the preemption quantum in timer ticks; 0 means threads only
+ * switch when they yield. */
+void ulthread_set_quantum(int ticks) {
+  preempt_quantum = ticks > 0 ? ticks : 0;
+}
+
+/* Turn the library's trace messages on or off; benchmarks turn
+ * them off so printing does not swamp what they measure. */
+void ulthread_set_trace(bool on) {
+  tracing = on;
+}
+
+/* Set the number of workers ulthread_schedule() runs threads on,
+ * at most one per hart is useful. Call after ulthread_init(). */
+bool ulthread_set_workers(int n) {
+  if (n < 1 || n > MAXWORKERS)
+    return false;
+  nworkers = n;
+  return true;
+}
+
+/* Timer upcall: put the running thread back in the run queue. */
+static void preempt(void *frame) {
+  struct worker *w = mywork();
+
+  if (!w->busy && w->current_thread != 0 && w->current_thread->state == RUNNING) {
+    w->busy = true;
+    trace("[*] ultpreempt(tid: %d)\n", w->current_thread->thread_id);
+    w->current_thread->state = RUNNABLE;
+    w->scheduler_thread.state = RUNNING;
+    ulthread_context_switch(&w->current_thread->context, &w->scheduler_thread.context);
+
+    // The thread may have resumed on another worker; the frame
+    // must not restore the old worker's tp (regs[3] in the frame).
+    w = mywork();
+    ((uint64 *)frame)[4] = (uint64)w;
+    w->busy = false;
+  }
+  upcallret(frame);
+}
+
+/* First code a new thread runs: leave the library, then call the
+ * thread function with its arguments. */
+static void thread_entry(uint64 a0, uint64 a1, uint64 a2, uint64 a3, uint64 a4, uint64 a5) {
+  uint64 (*start)(uint64, uint64, uint64, uint64, uint64, uint64);
+  struct worker *w = mywork();
+
+  start = (void *)w->current_thread->start;
+  w->busy = false;
+  ulthread_exit(start(a0, a1, a2, a3, a4, a5));
+}
 
 /* Get thread ID*/
 int get_current_tid() {
-  return current_thread->thread_id;
+  int tid = lib_enter()->current_thread->thread_id;
+
+  lib_leave();
+  return tid;
+}
+
+/* Get the number of the worker running this thread */
+int get_current_worker() {
+  return mywork()->id;
+}
+
+/* Get the number of threads worker id took from the others */
+int ulthread_steals(int id) {
+  return id >= 0 && id < MAXWORKERS ? workers[id].steals : 0;
 }
 
 /* Thread initialization */
 void ulthread_init(int schedalgo) {
-  // Initialize free user level threads
-  for (int i = 0; i < MAXULTHREADS; i++) {
-    threads[i].thread_id = 0;
-    threads[i].state = FREE;
-    threads[i].priority = -1;
-    threads[i].last_scheduled_time = 0;
-  } 
-  
-  // Initialize running scheduler thread
-  scheduler_thread.thread_id = 0;
-  scheduler_thread.state = RUNNING;
-  scheduler_thread.priority = -1;
-  scheduler_thread.last_scheduled_time = 0;
-  
+  struct worker *w;
+
+  for (int i = 0; i < MAXWORKERS; i++) {
+    w = &workers[i];
+    w->id = i;
+    w->pid = 0;
+    w->lock.locked = 0;
+    w->ready_queue.head = w->ready_queue.tail = 0;
+    for (int j = 0; j < MAXPRIO; j++)
+      w->prio_queues[j].head = w->prio_queues[j].tail = 0;
+    w->prio_bitmap = 0;
+    w->parked = 0;
+    w->ntimers = 0;
+    w->current_thread = 0;
+    w->busy = false;
+    w->steals = 0;
+
+    // Initialize running scheduler thread
+    w->scheduler_thread.thread_id = 0;
+    w->scheduler_thread.state = RUNNING;
+    w->scheduler_thread.priority = -1;
+  }
+  nworkers = 1;
+  next_worker = 0;
+  tracing = true;
   scheduling_algorithm = schedalgo;
+
+  // This process is worker 0.
+  asm volatile("mv tp, %0" : : "r" (&workers[0]));
 }
 
-/* Thread creation */
-bool ulthread_create(uint64 start, uint64 stack, uint64 args[], int priority) {
-  // Take the first free thread and assign ulthread values
-  int i;
-  for (i = 0; i < MAXULTHREADS; i++) {
-    if (threads[i].state == FREE)
-      break;
-  }   
-  threads[i].thread_id = next_thread_tid++;
-  threads[i].priority = priority;
-  threads[i].stack = stack - PGSIZE;
-  threads[i].last_scheduled_time = 0;
-  threads[i].state = RUNNABLE;   
-  memset(&threads[i].context, 0, sizeof(threads[i].context));
-  threads[i].context.ra = start;
-  threads[i].context.sp = stack;
-  threads[i].context.a0 = args[0];
-  threads[i].context.a1 = args[1];
-  threads[i].context.a2 = args[2];
-  threads[i].context.a3 = args[3];
-  threads[i].context.a4 = args[4];
-  threads[i].context.a5 = args[5];
+/* Create a thread; return its id, or 0 if out of memory. */
+static int create(uint64 start, uint64 stack, uint64 args[], int priority, bool joinable) {
+  struct ulthread *t;
+  struct worker *target;
+  int tid;
+
+  lib_enter();
+  ullock_acquire(&pool_lock);
+  if ((t = alloc_thread()) == 0) {
+    ullock_release(&pool_lock);
+    lib_leave();
+    return 0;
+  }
+  t->pooled_stack = (stack == 0);
+  if (t->pooled_stack) {
+    if ((t->stack = alloc_stack()) == 0) {
+      t->next = free_threads;
+      free_threads = t;
+      ullock_release(&pool_lock);
+      lib_leave();
+      return 0;
+    }
+    stack = t->stack + stack_pages * PGSIZE;
+  } else {
+    t->stack = stack - PGSIZE;
+  }
+
+  tid = t->thread_id = next_thread_tid++;
+  target = &workers[next_worker];
+  next_worker = (next_worker + 1) % nworkers;
+  ullock_release(&pool_lock);
+
+  t->joinable = joinable;
+  t->joined = false;
+  t->retval = 0;
+  t->joiners.head = t->joiners.tail = 0;
+  if (joinable) {
+    ullock_acquire(&join_lock);
+    t->hnext = joinable_threads[tid % NTIDHASH];
+    joinable_threads[tid % NTIDHASH] = t;
+    ullock_release(&join_lock);
+  }
+
+  t->priority = priority;
+  t->state = RUNNABLE;   
+  memset(&t->context, 0, sizeof(t->context));
+  t->start = start;
+  t->context.ra = (uint64)ulthread_start;
+  t->context.sp = stack;
+  t->context.s0 = args[0];
+  t->context.s1 = args[1];
+  t->context.s2 = args[2];
+  t->context.s3 = args[3];
+  t->context.s4 = args[4];
+  t->context.s5 = args[5];
+  t->context.s6 = (uint64)thread_entry;
     
-  printf("[*] ultcreate(tid: %d, ra: %p, sp: %p)\n", threads[i].thread_id, start, stack);
-  runnable_threads++;
-  return false;
+  trace("[*] ultcreate(tid: %d, ra: %p, sp: %p)\n", t->thread_id, start, stack);
+  __sync_fetch_and_add(&runnable_threads, 1);
+  ullock_acquire(&target->lock);
+  enqueue(target, t, false);
+  ullock_release(&target->lock);
+  lib_leave();
+  return tid;
 }
 
-/* Thread scheduler */
-void ulthread_schedule(void) {
+/* Thread creation. If stack is 0, the library allocates one. The
+ * thread's resources are freed as soon as it finishes. */
+int ulthread_create(uint64 start, uint64 stack, uint64 args[], int priority) {
+  return create(start, stack, args, priority, false);
+}
+
+/* Like ulthread_create(), but the thread is kept after it finishes
+ * until ulthread_join() collects its return value, or until
+ * ulthread_detach(). */
+int ulthread_create_joinable(uint64 start, uint64 stack, uint64 args[], int priority) {
+  return create(start, stack, args, priority, true);
+}
+
+/* Wait for joinable thread tid to finish and free it, storing its
+ * return value in *retval if retval is not 0. Returns false if tid
+ * is not a joinable thread or another join has claimed it. Outside
+ * a thread (after ulthread_schedule()) it cannot wait, and returns
+ * false unless tid has already finished. */
+bool ulthread_join(int tid, uint64 *retval) {
+  struct worker *w = lib_enter();
+  struct ulthread *t;
+
+  ullock_acquire(&join_lock);
+  t = find_joinable(tid, false);
+  if (t == 0 || t->joined || t == w->current_thread ||
+      (t->state != ZOMBIE && w->current_thread == 0)) {
+    ullock_release(&join_lock);
+    lib_leave();
+    return false;
+  }
+  t->joined = true;
+  while (t->state != ZOMBIE) {
+    park(&t->joiners, &join_lock);
+    ullock_acquire(&join_lock);
+  }
+  find_joinable(tid, true);
+  ullock_release(&join_lock);
+
+  if (retval)
+    *retval = t->retval;
+  free_thread(t);
+  lib_leave();
+  return true;
+}
+
+/* Let joinable thread tid be freed as soon as it finishes, instead
+ * of waiting for a join. Returns false if there is no such thread
+ * or a join has claimed it. */
+bool ulthread_detach(int tid) {
+  struct ulthread *t;
+  bool finished;
+
+  lib_enter();
+  ullock_acquire(&join_lock);
+  t = find_joinable(tid, false);
+  if (t == 0 || t->joined) {
+    ullock_release(&join_lock);
+    lib_leave();
+    return false;
+  }
+  // Decide who frees t while holding join_lock: after it is
+  // released, finish_thread() may free a thread that is not a
+  // ZOMBIE yet.
+  find_joinable(tid, true);
+  t->joinable = false;
+  finished = (t->state == ZOMBIE);
+  ullock_release(&join_lock);
+  if (finished)
+    free_thread(t);
+  lib_leave();
+  return true;
+}
+
+/* The scheduler has switched off t, which has exited. A joinable
+ * thread keeps its control block, with its return value, for
+ * ulthread_join(); the rest is freed now. */
+static void finish_thread(struct ulthread *t) {
+  // Before it is a ZOMBIE, which a join may free at once.
+  free_stack(t);
+
+  ullock_acquire(&join_lock);
+  if (t->joinable) {
+    t->state = ZOMBIE;
+    unpark(&t->joiners);
+    ullock_release(&join_lock);
+    return;
+  }
+  ullock_release(&join_lock);
+  free_thread(t);
+}
+
+/* Move w's parked threads whose fds have become ready to its run
+ * queue. */
+static void poll_parked(struct worker *w) {
+  struct ulthread **pp, *t;
+
+  for (pp = &w->parked; (t = *pp) != 0; ) {
+    if (ioready(t->waitfd, t->waitwrite, 1) == 0) {
+      pp = &t->next;
+      continue;
+    }
+    *pp = t->next;
+    t->state = RUNNABLE;
+    ullock_acquire(&w->lock);
+    enqueue(w, t, false);
+    ullock_release(&w->lock);
+  }
+}
+
+/* Nothing here to run but threads waiting for timeouts: sleep in
+ * the kernel until the earliest. */
+static void idle_until(struct worker *w) {
+  uint64 now = uptime(), when;
+
+  ullock_acquire(&w->lock);
+  when = w->ntimers > 0 ? w->timers[0]->wakeat : now;
+  ullock_release(&w->lock);
+  if (when > now)
+    sleep(when - now);
+}
+
+/* A worker's scheduler loop, until every thread has finished */
+static void run_worker(struct worker *w) {
+  struct ulthread *next, *cur;
+
+  w->busy = true;
+  if (preempt_quantum > 0)
+    upcall(preempt_quantum, preempt);
+
   while (runnable_threads > 0) {
-    int next_scheduled_idx = -1;
-    int current_scheduled_idx;
-    
-    for (int i = 0; i < MAXULTHREADS; i++) {
-      if (threads[i].state != RUNNABLE) {
-        continue;
-      }        
-      if (current_thread != 0 && threads[i].thread_id == current_thread->thread_id) {
-        current_scheduled_idx = i;
-        continue;
-      }
+    if (w->parked != 0)
+      poll_parked(w);
+    if (w->ntimers > 0)
+      expire_timers(w);
+    ullock_acquire(&w->lock);
+    next = dequeue(w);
+    ullock_release(&w->lock);
+    if (next == 0)
+      next = steal(w);
 
-      // Determine index of next thread according to scheduling algorithm
-      switch (scheduling_algorithm) {
-        case FCFS:
-        case ROUNDROBIN:
-          if (next_scheduled_idx == -1 || threads[i].last_scheduled_time < threads[next_scheduled_idx].last_scheduled_time) {
-	    next_scheduled_idx = i;
-          }
-	  break;
-        case PRIORITY:
-          if (next_scheduled_idx == -1 || threads[i].priority > threads[next_scheduled_idx].priority) {
-            next_scheduled_idx = i;
-          }
+    // A thread that just yielded runs again only if no other thread is
+    // ready. Under FCFS it keeps its place at the front of the queue.
+    cur = w->current_thread;
+    if (cur != 0 && cur->state == RUNNABLE) {
+      if (next == 0) {
+        next = cur;
+      } else {
+        ullock_acquire(&w->lock);
+        enqueue(w, cur, scheduling_algorithm == FCFS);
+        ullock_release(&w->lock);
       }
     }
-    // Last runnable thread
-    if (next_scheduled_idx == -1) {
-      next_scheduled_idx = current_scheduled_idx;
+    if (next == 0) {
+      // The others' threads are all running, or every thread here
+      // waits. For a timeout alone, sleep in the kernel until the
+      // first one; otherwise back off for a tick, so idle workers
+      // do not spin on harts the processes we wait for need.
+      if (w->parked == 0 && w->ntimers > 0)
+        idle_until(w);
+      else
+        sleep(1);
+      continue;
     }
     
     // Context switch from scheduler to next scheduled user thread
-    scheduler_thread.state = RUNNABLE;
-    current_thread = &threads[next_scheduled_idx];
-    current_thread->state = RUNNING;
+    w->scheduler_thread.state = RUNNABLE;
+    w->current_thread = next;
+    next->state = RUNNING;
         
     /* Add this statement to denote which thread-id is being scheduled next */
-    printf("[*] ultschedule (next tid: %d)\n", current_thread->thread_id);
-    ulthread_context_switch(&scheduler_thread.context, &current_thread->context);
+    trace("[*] ultschedule (next tid: %d)\n", next->thread_id);
+    ulthread_context_switch(&w->scheduler_thread.context, &next->context);
+
+    // A destroyed thread is off its stack now, so both can be reused.
+    // A thread waiting for I/O is parked until its fd is ready.
+    if (w->current_thread->state == FREE) {
+      finish_thread(w->current_thread);
+      w->current_thread = 0;
+    } else if (w->current_thread->state == WAITIO) {
+      w->current_thread->next = w->parked;
+      w->parked = w->current_thread;
+      w->current_thread = 0;
+    } else if (w->current_thread->state == WAITING) {
+      // Now a waker may run it, on any worker.
+      w->current_thread = 0;
+      ullock_release(w->park_lock);
+    }
   }  
+
+  if (preempt_quantum > 0)
+    upcall(0, 0);
+  w->busy = false;
+}
+
+/* Entry point of a cloned worker */
+static void worker_main(void *arg) {
+  struct worker *w = arg;
+
+  asm volatile("mv tp, %0" : : "r" (w));
+  run_worker(w);
+  exit(0);
+}
+
+/* Thread scheduler: run the threads on nworkers workers, and return
+ * when all have finished. The workers are child processes, and
+ * waiting for them reaps any child that exits meanwhile: a
+ * program that also forks should wait for its own children before
+ * its last thread finishes, or lose their exit status. */
+void ulthread_schedule(void) {
+  struct worker *w;
+  int i, pid, nclones = 0;
+
+  for (i = 1; i < nworkers; i++) {
+    w = &workers[i];
+    if (w->stack == 0 && (w->stack = malloc(WORKERSTACK)) == 0)
+      break;
+    // Its threads are stolen by the others if it cannot start.
+    w->pid = clone(worker_main, w, (void *)(((uint64)w->stack + WORKERSTACK) & ~15L));
+    if (w->pid < 0)
+      break;
+    nclones++;
+  }
+
+  run_worker(&workers[0]);
+
+  // Wait for each worker by pid, so reaping another child does
+  // not let us return while a worker still runs.
+  while (nclones > 0 && (pid = wait(0)) >= 0) {
+    for (i = 1; i < nworkers; i++) {
+      if (workers[i].pid == pid) {
+        workers[i].pid = 0;
+        nclones--;
+        break;
+      }
+    }
+  }
 }
 
 /* Yield CPU time to some other thread. */
 void ulthread_yield(void) {
-  printf("[*] ultyield(tid: %d)\n", current_thread->thread_id);
+  struct worker *w = lib_enter();
 
-  // ROUNDROBIN yields based on current time, FCFS doesn't yield until completion
-  if (scheduling_algorithm != FCFS) {
-    current_thread->last_scheduled_time = ctime();
-  }
+  trace("[*] ultyield(tid: %d)\n", w->current_thread->thread_id);
 
   // Context switch from currently scheduled user thread to scheduler
-  current_thread->state = RUNNABLE;
-  scheduler_thread.state = RUNNING;
-  ulthread_context_switch(&current_thread->context, &scheduler_thread.context);
+  w->current_thread->state = RUNNABLE;
+  w->scheduler_thread.state = RUNNING;
+  ulthread_context_switch(&w->current_thread->context, &w->scheduler_thread.context);
+  lib_leave();
+}
+
+/* Finish the running thread with return value retval. */
+void ulthread_exit(uint64 retval) {
+  struct worker *w = lib_enter();
+
+  w->current_thread->retval = retval;
+  w->current_thread->state = FREE;
+  w->scheduler_thread.state = RUNNING;
+  trace("[*] ultdestroy(tid: %d)\n", w->current_thread->thread_id);
+  __sync_fetch_and_sub(&runnable_threads, 1);
+  ulthread_context_switch(&w->current_thread->context, &w->scheduler_thread.context);
 }
 
 /* Destroy thread */
 void ulthread_destroy(void) {
-  current_thread->state = FREE;
-  scheduler_thread.state = RUNNING;
-  printf("[*] ultdestroy(tid: %d)\n", current_thread->thread_id);
-  runnable_threads--;
-  ulthread_context_switch(&current_thread->context, &scheduler_thread.context);
+  ulthread_exit(0);
+}
+
+/* Sleep for ticks timer ticks, letting the worker run other
+ * threads meanwhile. */
+void ulthread_sleep(int ticks) {
+  struct worker *w;
+
+  if (ticks <= 0)
+    return;
+  w = lib_enter();
+  trace("[*] ultsleep(tid: %d, ticks: %d)\n", w->current_thread->thread_id, ticks);
+  ullock_acquire(&w->lock);
+  park_until(0, &w->lock, uptime() + ticks);
+  lib_leave();
+}
+
+/* Park the running thread until fd is ready to read (or write),
+ * letting the worker run other threads meanwhile. */
+static void wait_io(int fd, bool write) {
+  struct worker *w = lib_enter();
+
+  trace("[*] ultwaitio(tid: %d, fd: %d)\n", w->current_thread->thread_id, fd);
+  w->current_thread->waitfd = fd;
+  w->current_thread->waitwrite = write;
+  w->current_thread->state = WAITIO;
+  w->scheduler_thread.state = RUNNING;
+  ulthread_context_switch(&w->current_thread->context, &w->scheduler_thread.context);
+  lib_leave();
+}
+
+/* read() that blocks only the calling thread, not its worker.
+ * The data can still be taken by another reader of fd between the
+ * check and the read, and then the worker blocks. */
+int ulthread_read(int fd, void *buf, int n) {
+  int r;
+
+  if (n > 0 && mywork()->current_thread != 0) {
+    while ((r = ioready(fd, 0, n)) == 0)
+      wait_io(fd, false);
+    if (r < 0)
+      return -1;
+  }
+  return read(fd, buf, n);
+}
+
+/* write() that blocks only the calling thread, writing as much at a
+ * time as fits without the kernel waiting for a reader. */
+int ulthread_write(int fd, const void *buf, int n) {
+  int r, done = 0;
+
+  if (mywork()->current_thread == 0)
+    return write(fd, buf, n);
+  while (done < n) {
+    while ((r = ioready(fd, 1, n - done)) == 0)
+      wait_io(fd, true);
+    if (r < 0 || (r = write(fd, (char *)buf + done, r)) <= 0)
+      return done > 0 ? done : -1;
+    done += r;
+  }
+  return done;
+}
+
+void ulmutex_init(struct ulmutex *m) {
+  memset(m, 0, sizeof(*m));
+}
+
+void ulmutex_lock(struct ulmutex *m) {
+  lib_enter();
+  ullock_acquire(&m->lk);
+  if (!m->locked) {
+    m->locked = true;
+    ullock_release(&m->lk);
+  } else {
+    park(&m->waiters, &m->lk);  // unlock hands it over
+  }
+  lib_leave();
+}
+
+/* Hand the mutex straight to the first waiter, if any, so a thread
+ * that has not waited cannot take it first. */
+static void mutex_unlock(struct ulmutex *m) {
+  ullock_acquire(&m->lk);
+  if (!unpark(&m->waiters))
+    m->locked = false;
+  ullock_release(&m->lk);
+}
+
+void ulmutex_unlock(struct ulmutex *m) {
+  lib_enter();
+  mutex_unlock(m);
+  lib_leave();
+}
+
+void ulcond_init(struct ulcond *c) {
+  memset(c, 0, sizeof(*c));
 }
 
+/* Release m and wait for a signal, then take m again. */
+void ulcond_wait(struct ulcond *c, struct ulmutex *m) {
+  lib_enter();
+  ullock_acquire(&c->lk);
+  mutex_unlock(m);
+  park(&c->waiters, &c->lk);
+  lib_leave();
+  ulmutex_lock(m);
+}
+
+/* Like ulcond_wait(), but stop waiting for a signal after ticks
+ * timer ticks. m is held again either way. Returns false if no
+ * signal came in time. */
+bool ulcond_timedwait(struct ulcond *c, struct ulmutex *m, int ticks) {
+  bool ok;
+
+  lib_enter();
+  ullock_acquire(&c->lk);
+  mutex_unlock(m);
+  ok = park_until(&c->waiters, &c->lk, uptime() + (ticks > 0 ? ticks : 1));
+  lib_leave();
+  ulmutex_lock(m);
+  return ok;
+}
+
+void ulcond_signal(struct ulcond *c) {
+  lib_enter();
+  ullock_acquire(&c->lk);
+  unpark(&c->waiters);
+  ullock_release(&c->lk);
+  lib_leave();
+}
+
+void ulcond_broadcast(struct ulcond *c) {
+  lib_enter();
+  ullock_acquire(&c->lk);
+  while (unpark(&c->waiters))
+    ;
+  ullock_release(&c->lk);
+  lib_leave();
+}
+
+void ulsem_init(struct ulsem *s, int count) {
+  memset(s, 0, sizeof(*s));
+  s->count = count;
+}
+
+void ulsem_wait(struct ulsem *s) {
+  lib_enter();
+  ullock_acquire(&s->lk);
+  if (s->count > 0) {
+    s->count--;
+    ullock_release(&s->lk);
+  } else {
+    park(&s->waiters, &s->lk);  // post hands over its count
+  }
+  lib_leave();
+}
+
+/* Like ulsem_wait(), but give up after ticks timer ticks.
+ * Returns false if it gave up. */
+bool ulsem_timedwait(struct ulsem *s, int ticks) {
+  bool ok = true;
+
+  lib_enter();
+  ullock_acquire(&s->lk);
+  if (s->count > 0) {
+    s->count--;
+    ullock_release(&s->lk);
+  } else if (ticks <= 0) {
+    ullock_release(&s->lk);
+    ok = false;
+  } else {
+    ok = park_until(&s->waiters, &s->lk, uptime() + ticks);
+  }
+  lib_leave();
+  return ok;
+}
+
+void ulsem_post(struct ulsem *s) {
+  lib_enter();
+  ullock_acquire(&s->lk);
+  if (!unpark(&s->waiters))
+    s->count++;
+  ullock_release(&s->lk);
+  lib_leave();
+}
+
+/* A channel holding up to size values. */
+bool ulchan_init(struct ulchan *ch, int size) {
+  memset(ch, 0, sizeof(*ch));
+  if (size < 1 || (ch->buf = malloc(size * sizeof(uint64))) == 0)
+    return false;
+  ch->size = size;
+  return true;
+}
+
+/* Send v, waiting while the channel is full. Returns false if
+ * the channel is closed. */
+bool ulchan_send(struct ulchan *ch, uint64 v) {
+  ulmutex_lock(&ch->m);
+  while (ch->count == ch->size && !ch->closed)
+    ulcond_wait(&ch->notfull, &ch->m);
+  if (ch->closed) {
+    ulmutex_unlock(&ch->m);
+    return false;
+  }
+  ch->buf[(ch->head + ch->count++) % ch->size] = v;
+  ulcond_signal(&ch->notempty);
+  ulmutex_unlock(&ch->m);
+  return true;
+}
+
+/* Receive the oldest value into *v, waiting while the channel is
+ * empty. Returns false once it is closed and drained. */
+bool ulchan_recv(struct ulchan *ch, uint64 *v) {
+  ulmutex_lock(&ch->m);
+  while (ch->count == 0 && !ch->closed)
+    ulcond_wait(&ch->notempty, &ch->m);
+  if (ch->count == 0) {
+    ulmutex_unlock(&ch->m);
+    return false;
+  }
+  *v = ch->buf[ch->head];
+  ch->head = (ch->head + 1) % ch->size;
+  ch->count--;
+  ulcond_signal(&ch->notfull);
+  ulmutex_unlock(&ch->m);
+  return true;
+}
+
+/* No more sends; wake everyone waiting on the channel. */
+void ulchan_close(struct ulchan *ch) {
+  ulmutex_lock(&ch->m);
+  ch->closed = true;
+  ulcond_broadcast(&ch->notempty);
+  ulcond_broadcast(&ch->notfull);
+  ulmutex_unlock(&ch->m);
+}
+
+void ulchan_free(struct ulchan *ch) {
+  free(ch->buf);
+  ch->buf = 0;
+}
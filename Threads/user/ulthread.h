@@ -3,13 +3,91 @@
 
 #include <stdbool.h>
 
-#define MAXULTHREADS 100
+#define MAXULTHREADS 100  // threads the tests give stacks to
+#define MAXPRIO      32   // priority levels, 0 (lowest) to MAXPRIO-1
+#define ULTBATCH     64   // thread control blocks allocated at a time
+#define MAXWORKERS   8    // kernel threads running ulthreads
+#define WORKERSTACK  (2*4096)  // scheduler stack of each cloned worker
 
 enum ulthread_state {
   FREE,
   RUNNABLE,
   YIELD,
   RUNNING,
+  WAITIO,       // parked until its fd is ready
+  WAITING,      // parked on a mutex, condition, semaphore or channel
+  ZOMBIE,       // finished, waiting for ulthread_join()
+};
+
+struct ulthread;
+
+/* Registers saved by ulthread_context_switch() in ulthread_swtch.S,
+ * which ulcoro also uses. A context that has never run starts at
+ * ulthread_start, which calls s6 with s0-s5 as its arguments. */
+struct context {
+  uint64 ra;
+  uint64 sp;
+  uint64 s0;
+  uint64 s1;
+  uint64 s2;
+  uint64 s3;
+  uint64 s4;
+  uint64 s5;
+  uint64 s6;
+  uint64 s7;
+  uint64 s8;
+  uint64 s9;
+  uint64 s10;
+  uint64 s11;
+};
+
+void ulthread_context_switch(struct context *, struct context *);
+void ulthread_start(void);
+
+/* A spinlock for state the workers share. Library code only takes
+ * one with its worker's busy flag set, so the holder is never
+ * preempted by the upcall. */
+struct ullock {
+  volatile int locked;
+};
+
+/* A FIFO of threads */
+struct ulqueue {
+  struct ulthread *head;
+  struct ulthread *tail;
+};
+
+/* Synchronization. Waiting threads are parked off the run queues
+ * and woken in the order they started waiting. Initialize with the
+ * _init functions (or zero them); only call the blocking functions
+ * from threads. */
+struct ulmutex {
+  struct ullock lk;
+  bool locked;
+  struct ulqueue waiters;
+};
+
+struct ulcond {
+  struct ullock lk;
+  struct ulqueue waiters;
+};
+
+struct ulsem {
+  struct ullock lk;
+  int count;
+  struct ulqueue waiters;
+};
+
+/* A bounded FIFO of values between threads */
+struct ulchan {
+  struct ulmutex m;
+  struct ulcond notempty;
+  struct ulcond notfull;
+  uint64 *buf;
+  int size;
+  int head;     // index of the oldest value
+  int count;    // values in buf
+  bool closed;
 };
 
 enum ulthread_scheduling_algorithm {
@@ -18,4 +96,42 @@ enum ulthread_scheduling_algorithm {
   FCFS,         // first-come-first serve
 };
 
+/* Library interface */
+void ulthread_init(int schedalgo);
+bool ulthread_set_stack(int npages, bool guard);
+void ulthread_set_quantum(int ticks);
+bool ulthread_set_workers(int n);
+void ulthread_set_trace(bool on);
+int ulthread_create(uint64 start, uint64 stack, uint64 args[], int priority);
+int ulthread_create_joinable(uint64 start, uint64 stack, uint64 args[], int priority);
+bool ulthread_join(int tid, uint64 *retval);
+bool ulthread_detach(int tid);
+void ulthread_exit(uint64 retval);
+void ulthread_schedule(void);
+void ulthread_yield(void);
+void ulthread_sleep(int ticks);
+void ulthread_destroy(void);
+int ulthread_read(int fd, void *buf, int n);
+int ulthread_write(int fd, const void *buf, int n);
+void ulmutex_init(struct ulmutex *m);
+void ulmutex_lock(struct ulmutex *m);
+void ulmutex_unlock(struct ulmutex *m);
+void ulcond_init(struct ulcond *c);
+void ulcond_wait(struct ulcond *c, struct ulmutex *m);
+bool ulcond_timedwait(struct ulcond *c, struct ulmutex *m, int ticks);
+void ulcond_signal(struct ulcond *c);
+void ulcond_broadcast(struct ulcond *c);
+void ulsem_init(struct ulsem *s, int count);
+void ulsem_wait(struct ulsem *s);
+bool ulsem_timedwait(struct ulsem *s, int ticks);
+void ulsem_post(struct ulsem *s);
+bool ulchan_init(struct ulchan *ch, int size);
+bool ulchan_send(struct ulchan *ch, uint64 v);
+bool ulchan_recv(struct ulchan *ch, uint64 *v);
+void ulchan_close(struct ulchan *ch);
+void ulchan_free(struct ulchan *ch);
+int get_current_tid(void);
+int get_current_worker(void);
+int ulthread_steals(int id);
+
 #endif
@@ -22,6 +22,12 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+uint64 ctime(void);
+int guardpage(void*);
+int upcall(int, void (*)(void*));
+int upcallret(void*);
+int clone(void (*)(void*), void*, void*);
+int ioready(int, int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
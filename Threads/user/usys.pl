@@ -37,3 +37,8 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("ctime");
+entry("guardpage");
+entry("upcall");
+entry("upcallret");
+entry("clone");
+entry("ioready");
@@ -190,6 +190,11 @@ void            virtio_disk_intr(void);
 // debug.c
 void            dump_hex(const void* data, size_t size);
 
+// trace.c
+void            traceinit(void);
+void            trace(int, char*, uint64, uint64, uint64);
+int             tracedump(uint64, int);
+
 // trap-and-emulate.c
 void            trap_and_emulate(void);
 void            trap_and_emulate_ecall(void);
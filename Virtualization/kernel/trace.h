@@ -0,0 +1,24 @@
+// Kernel trace events.
+// trace() records them in a per-CPU ring without taking a lock;
+// the tracedump() system call reads them, oldest first.
+// Both the kernel and user programs use this header file.
+
+#define TR_LOST  0  // arg: events this cpu overwrote unread
+
+// Privileged instructions emulated for a guest.
+// arg: guest pc, instruction, guest privilege mode.
+#define TR_ECALL 1
+#define TR_SRET  2
+#define TR_MRET  3
+#define TR_CSRW  4
+#define TR_CSRR  5
+
+struct traceev {
+  uint64 seq;       // index in its CPU's ring, plus one
+  uint64 time;      // time CSR when recorded
+  ushort type;      // TR_*
+  ushort cpu;
+  int pid;
+  uint64 arg[3];
+  char name[16];    // process name
+};
@@ -5,9 +5,19 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "trace.h"
 #include "stdbool.h"
 #include "stdlib.h"
 
+// Emulated instructions are recorded as trace events; the
+// tracedump program prints them. Build with TRACECONSOLE=1 to
+// print each on the console as well.
+#ifdef TRACECONSOLE
+#define tracecons(...) printf(__VA_ARGS__)
+#else
+#define tracecons(...)
+#endif
+
 #define U_MODE 0
 #define S_MODE 1
 #define M_MODE 2
@@ -31,19 +41,20 @@ void trap_and_emulate(void) {
     struct proc *p = myproc();
     uint64 virtual_addr = r_sepc();
     uint32 instruction = *((uint32*)(walkaddr(p->pagetable, virtual_addr) | (virtual_addr & 0xFFF)));
-    uint32 op = instruction & 0x7F;
     uint32 rd = (instruction >> 7) & 0x1F;
     uint32 funct3 = (instruction >> 12) & 0x7;
     uint32 rs1 = (instruction >> 15) & 0x1F;
     uint32 uimm = (instruction >> 20) & 0xFFF;
 
     if (funct3 == 0x0 && uimm == 0) {
-        printf("(ecall at %p)\n", p->trapframe->epc);
+        tracecons("(ecall at %p)\n", p->trapframe->epc);
+        trace(TR_ECALL, p->name, p->trapframe->epc, instruction, vm_state.privilege_mode);
         vm_state.vm_reg_map[0x141].val = p->trapframe->epc;
         p->trapframe->epc = vm_state.vm_reg_map[0x105].val;
         vm_state.privilege_mode = S_MODE;
     } else if (funct3 == 0x0 && uimm == 0x102 && vm_state.privilege_mode >= S_MODE) {
-        printf("(sret at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, op, rd, funct3, rs1, uimm);
+        tracecons("(sret at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, instruction & 0x7F, rd, funct3, rs1, uimm);
+        trace(TR_SRET, p->name, virtual_addr, instruction, vm_state.privilege_mode);
         uint64 sstatus = vm_state.vm_reg_map[0x100].val;
         vm_state.privilege_mode = ((sstatus >> 8) & 0x1) ? S_MODE : U_MODE;
         
@@ -54,7 +65,8 @@ void trap_and_emulate(void) {
         vm_state.vm_reg_map[0x100].val = sstatus;
         p->trapframe->epc = vm_state.vm_reg_map[0x141].val;
     } else if (funct3 == 0x0 && uimm == 0x302 && vm_state.privilege_mode >= M_MODE) {
-        printf("(mret at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, op, rd, funct3, rs1, uimm);
+        tracecons("(mret at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, instruction & 0x7F, rd, funct3, rs1, uimm);
+        trace(TR_MRET, p->name, virtual_addr, instruction, vm_state.privilege_mode);
         uint64 mstatus = vm_state.vm_reg_map[0x300].val;
         vm_state.privilege_mode = ((mstatus >> 11) & 0x1) ? S_MODE : U_MODE;
         
@@ -65,12 +77,14 @@ void trap_and_emulate(void) {
         vm_state.vm_reg_map[0x300].val = mstatus; // write mstatus register
         p->trapframe->epc = vm_state.vm_reg_map[0x341].val; // set the program counter to the value of mepc
     } else if (funct3 == 0x1 && vm_state.privilege_mode >= vm_state.vm_reg_map[uimm].mode) {
-        printf("(csrw at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, op, rd, funct3, rs1, uimm);
+        tracecons("(csrw at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, instruction & 0x7F, rd, funct3, rs1, uimm);
+        trace(TR_CSRW, p->name, virtual_addr, instruction, vm_state.privilege_mode);
         uint64* rs1_reg= &(p->trapframe->ra) + rs1 - 1;
         vm_state.vm_reg_map[uimm].val = *rs1_reg;
         p->trapframe->epc += 4;
     } else if (funct3 == 0x2 && vm_state.privilege_mode >= vm_state.vm_reg_map[uimm].mode) {
-        printf("(csrr at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, op, rd, funct3, rs1, uimm);
+        tracecons("(csrr at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x\n", virtual_addr, instruction & 0x7F, rd, funct3, rs1, uimm);
+        trace(TR_CSRR, p->name, virtual_addr, instruction, vm_state.privilege_mode);
         uint64* rd_reg = &(p->trapframe->ra) + rd - 1;
         *rd_reg = vm_state.vm_reg_map[uimm].val;
         p->trapframe->epc += 4;
@@ -0,0 +1,65 @@
+// Print the kernel's unread trace events, oldest first, in the
+// lines the kernel prints when built with TRACECONSOLE. -t
+// prefixes each with its time, cpu, pid, and process name, and
+// appends the guest's privilege mode.
+//
+//   tracedump [-t]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+struct traceev ev[32];
+int tflag;
+
+char *names[] = {
+[TR_ECALL] "ecall",
+[TR_SRET]  "sret",
+[TR_MRET]  "mret",
+[TR_CSRW]  "csrw",
+[TR_CSRR]  "csrr",
+};
+
+void
+print(struct traceev *e)
+{
+  uint insn = e->arg[1];
+
+  if(e->type == TR_LOST){
+    fprintf(2, "tracedump: cpu%d lost %d events\n", e->cpu, (int)e->arg[0]);
+    return;
+  }
+  if(tflag)
+    printf("%l cpu%d pid %d (%s): ", e->time, e->cpu, e->pid, e->name);
+  if(e->type >= sizeof(names)/sizeof(names[0])){
+    printf("event %d\n", e->type);
+    return;
+  }
+  if(e->type == TR_ECALL)
+    printf("(ecall at %p)", e->arg[0]);
+  else
+    printf("(%s at %p) op = %x, rd = %x, funct3 = %x, rs1 = %x, uimm = %x",
+           names[e->type], e->arg[0], insn & 0x7F, (insn >> 7) & 0x1F,
+           (insn >> 12) & 0x7, (insn >> 15) & 0x1F, (insn >> 20) & 0xFFF);
+  if(tflag)
+    printf(", mode %d", (int)e->arg[2]);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n;
+
+  if(argc > 1 && strcmp(argv[1], "-t") == 0)
+    tflag = 1;
+  else if(argc > 1){
+    fprintf(2, "usage: tracedump [-t]\n");
+    exit(1);
+  }
+  while((n = tracedump(ev, sizeof(ev)/sizeof(ev[0]))) > 0)
+    for(i = 0; i < n; i++)
+      print(&ev[i]);
+  exit(0);
+}
@@ -1,4 +1,5 @@
 struct stat;
+struct traceev;
 
 // system calls
 int fork(void);
@@ -22,6 +23,7 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int tracedump(struct traceev*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);